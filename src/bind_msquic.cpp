@@ -1,6 +1,5 @@
 // nanobind
 #include <nanobind/nanobind.h>
-#include <nanobind/stl/function.h>
 #include <nanobind/stl/optional.h>
 #include <nanobind/stl/shared_ptr.h>
 #include <nanobind/stl/string.h>
@@ -10,75 +9,71 @@
 // msquic
 #include <msquic.h>
 
-// quic_var_int.h を使用するために必要なマクロを定義
-#ifndef QUIC_INLINE
-#define QUIC_INLINE static inline
-#endif
-#ifndef CXPLAT_DBG_ASSERT
-#define CXPLAT_DBG_ASSERT(exp)
-#endif
-#ifndef CXPLAT_ANALYSIS_ASSERT
-#define CXPLAT_ANALYSIS_ASSERT(exp)
-#endif
-
-// バイトスワップ関数: Windows (MSVC) と GCC/Clang で異なる
-#ifdef _MSC_VER
-#include <stdlib.h>
-#ifndef CxPlatByteSwapUint16
-#define CxPlatByteSwapUint16(value) _byteswap_ushort((unsigned short)(value))
-#endif
-#ifndef CxPlatByteSwapUint32
-#define CxPlatByteSwapUint32(value) _byteswap_ulong((unsigned long)(value))
-#endif
-#ifndef CxPlatByteSwapUint64
-#define CxPlatByteSwapUint64(value) _byteswap_uint64((unsigned long long)(value))
-#endif
-#else
-#ifndef CxPlatByteSwapUint16
-#define CxPlatByteSwapUint16(value) __builtin_bswap16((unsigned short)(value))
-#endif
-#ifndef CxPlatByteSwapUint32
-#define CxPlatByteSwapUint32(value) __builtin_bswap32((value))
-#endif
-#ifndef CxPlatByteSwapUint64
-#define CxPlatByteSwapUint64(value) __builtin_bswap64((value))
-#endif
-#endif
-
-#include <quic_var_int.h>
-
 #include <atomic>
 #include <cstring>
-#include <functional>
 #include <memory>
 #include <mutex>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace nb = nanobind;
 using namespace nb::literals;
 
+// コード配置のヒント: イベントディスパッチャはホット、証明書
+// ロードなどの設定系はコールドとして分離する (GCC / Clang のみ)
+#if defined(__GNUC__)
+#define MSQUIC_PY_HOT __attribute__((hot))
+#define MSQUIC_PY_COLD __attribute__((cold))
+#else
+#define MSQUIC_PY_HOT
+#define MSQUIC_PY_COLD
+#endif
+
 namespace msquic_py {
 
+// MsQuic API の失敗を表す例外
+// Python 側には msquic.QuicError (RuntimeError 派生) として公開する
+struct QuicError : std::runtime_error {
+  using std::runtime_error::runtime_error;
+};
+
 // グローバル API テーブル
 const QUIC_API_TABLE* g_MsQuic = nullptr;
+std::once_flag g_MsQuicOnceFlag;
 std::mutex g_MsQuicMutex;
+std::atomic<bool> g_MsQuicClosed{false};
 
 // API を開く
+// Registration 生成のたびに呼ばれるため、初期化済みの場合は
+// mutex の RMW を避けて call_once の acquire ロードだけで抜ける
+// 初期化失敗時は例外で抜け、次回の呼び出しで再試行される
+// close_api 後の再オープンはサポートしないため QuicError を投げる
 void open_api() {
-  std::lock_guard<std::mutex> lock(g_MsQuicMutex);
-  if (g_MsQuic == nullptr) {
+  std::call_once(g_MsQuicOnceFlag, [] {
+    // 初期化は close_api と mutex で直列化する。直列化しないと
+    // 初期化中に close_api が走ったとき、close は null を見て閉じずに
+    // 戻り、開いたままの API テーブルがリークする
+    std::lock_guard<std::mutex> lock(g_MsQuicMutex);
+    if (g_MsQuicClosed.load(std::memory_order_relaxed)) {
+      throw QuicError("MsQuic API is already closed");
+    }
     QUIC_STATUS status = MsQuicOpenVersion(QUIC_API_VERSION_2, (const void**)&g_MsQuic);
     if (QUIC_FAILED(status)) {
-      throw std::runtime_error("Failed to open MsQuic API");
+      throw QuicError("Failed to open MsQuic API");
     }
+  });
+  if (g_MsQuicClosed.load(std::memory_order_acquire)) {
+    throw QuicError("MsQuic API is already closed");
   }
 }
 
 // API を閉じる
+// プロセス終了時の後始末用。close 後の再オープンはサポートしない
 void close_api() {
   std::lock_guard<std::mutex> lock(g_MsQuicMutex);
+  g_MsQuicClosed.store(true, std::memory_order_release);
   if (g_MsQuic != nullptr) {
     MsQuicClose(g_MsQuic);
     g_MsQuic = nullptr;
@@ -89,17 +84,69 @@ void close_api() {
 class Stream;
 class Connection;
 
+// グローバル実行設定
+// XDP によるカーネルバイパスやポーリング、ワーカーの CPU 割り当てを
+// 設定する。Registration 生成より前に呼び出すこと
+void set_execution_config(bool use_xdp,
+                          uint32_t polling_idle_timeout_us,
+                          nb::sequence processor_list) {
+  open_api();
+#ifdef QUIC_PARAM_GLOBAL_EXECUTION_CONFIG
+  // ProcessorList が可変長のため、必要サイズをまとめて確保して
+  // 先頭を QUIC_GLOBAL_EXECUTION_CONFIG として使う
+  size_t processor_count = nb::len(processor_list);
+  std::vector<uint8_t> storage(QUIC_GLOBAL_EXECUTION_CONFIG_MIN_SIZE +
+                               sizeof(uint16_t) * processor_count);
+  auto* config = reinterpret_cast<QUIC_GLOBAL_EXECUTION_CONFIG*>(storage.data());
+  config->Flags = use_xdp ? QUIC_GLOBAL_EXECUTION_CONFIG_FLAG_XDP
+                          : QUIC_GLOBAL_EXECUTION_CONFIG_FLAG_NONE;
+  config->PollingIdleTimeoutUs = polling_idle_timeout_us;
+  config->ProcessorCount = static_cast<uint32_t>(processor_count);
+  size_t index = 0;
+  for (nb::handle item : processor_list) {
+    config->ProcessorList[index++] = nb::cast<uint16_t>(item);
+  }
+
+  QUIC_STATUS status;
+  {
+    // GIL を解放して MsQuic API を呼び出す
+    nb::gil_scoped_release release;
+    status = g_MsQuic->SetParam(
+        nullptr,
+        QUIC_PARAM_GLOBAL_EXECUTION_CONFIG,
+        static_cast<uint32_t>(storage.size()),
+        config);
+  }
+  if (QUIC_FAILED(status)) {
+    throw QuicError("Failed to set execution config");
+  }
+#else
+  (void)use_xdp;
+  (void)polling_idle_timeout_us;
+  (void)processor_list;
+  throw QuicError("Execution config is not supported by this MsQuic build");
+#endif
+}
+
 // ========== Registration ==========
 class Registration {
  public:
-  Registration(const std::string& app_name, QUIC_EXECUTION_PROFILE profile) {
+  // 文字列引数は const char* で受け、nanobind の std::string キャスタに
+  // よる中間コピーを挟まず Python 文字列の UTF-8 表現を直接渡す
+  // (ポインタは呼び出しの間だけ有効。MsQuic 側は内部でコピーする)
+  Registration(const char* app_name, QUIC_EXECUTION_PROFILE profile) {
     open_api();
     QUIC_REGISTRATION_CONFIG config = {0};
-    config.AppName = app_name.c_str();
+    config.AppName = app_name;
     config.ExecutionProfile = profile;
-    QUIC_STATUS status = g_MsQuic->RegistrationOpen(&config, &handle_);
+    QUIC_STATUS status;
+    {
+      // GIL を解放して MsQuic API を呼び出す
+      nb::gil_scoped_release release;
+      status = g_MsQuic->RegistrationOpen(&config, &handle_);
+    }
     if (QUIC_FAILED(status)) {
-      throw std::runtime_error("Failed to open registration");
+      throw QuicError("Failed to open registration");
     }
   }
 
@@ -111,6 +158,8 @@ class Registration {
 
   void shutdown(QUIC_CONNECTION_SHUTDOWN_FLAGS flags, uint64_t error_code) {
     if (handle_ != nullptr && g_MsQuic != nullptr) {
+      // GIL を解放して MsQuic API を呼び出す
+      nb::gil_scoped_release release;
       g_MsQuic->RegistrationShutdown(handle_, flags, error_code);
     }
   }
@@ -128,24 +177,46 @@ class Registration {
   HQUIC handle_ = nullptr;
 };
 
+// ALPN のシーケンスから QUIC_BUFFER 配列を構築する
+// storage に文字列の実体を保持し、buffers はそこを指す
+void build_alpn_buffers(nb::sequence alpn_list,
+                        std::vector<std::string>& storage,
+                        std::vector<QUIC_BUFFER>& buffers) {
+  // str / bytes もシーケンスとして通ってしまい、"h3" が黙って
+  // ["h", "3"] になりハンドシェイク失敗として現れるため明示的に拒否する
+  if (PyUnicode_Check(alpn_list.ptr()) || PyBytes_Check(alpn_list.ptr())) {
+    throw nb::type_error("alpn_list must be a sequence of str, not str or bytes");
+  }
+  size_t count = nb::len(alpn_list);
+  storage.clear();
+  storage.reserve(count);
+  buffers.clear();
+  buffers.reserve(count);
+  for (nb::handle item : alpn_list) {
+    storage.push_back(nb::cast<std::string>(item));
+  }
+  for (const auto& alpn : storage) {
+    QUIC_BUFFER buf;
+    buf.Length = static_cast<uint32_t>(alpn.size());
+    buf.Buffer = (uint8_t*)alpn.data();
+    buffers.push_back(buf);
+  }
+}
+
 // ========== Configuration ==========
 class Configuration {
  public:
   Configuration(Registration& registration,
-                const std::vector<std::string>& alpn_list,
+                nb::sequence alpn_list,
                 uint64_t idle_timeout_ms = 0,
                 uint16_t peer_bidi_stream_count = 0,
                 uint16_t peer_unidi_stream_count = 0,
                 bool datagram_receive_enabled = false,
                 QUIC_SERVER_RESUMPTION_LEVEL server_resumption_level = QUIC_SERVER_NO_RESUME) {
-    // ALPN バッファを構築
-    std::vector<QUIC_BUFFER> alpn_buffers;
-    for (const auto& alpn : alpn_list) {
-      QUIC_BUFFER buf;
-      buf.Length = static_cast<uint32_t>(alpn.size());
-      buf.Buffer = (uint8_t*)alpn.data();
-      alpn_buffers.push_back(buf);
-    }
+    // ALPN バッファを一度だけ構築してメンバーに保持する
+    // nanobind の STL キャスタによる vector<string> の中間コピーを挟まず
+    // Python シーケンスから直接取り出す
+    build_alpn_buffers(alpn_list, alpn_storage_, alpn_buffers_);
 
     // Settings を構築
     QUIC_SETTINGS settings = {0};
@@ -168,16 +239,21 @@ class Configuration {
     settings.ServerResumptionLevel = server_resumption_level;
     settings.IsSet.ServerResumptionLevel = TRUE;
 
-    QUIC_STATUS status = g_MsQuic->ConfigurationOpen(
-        registration.handle(),
-        alpn_buffers.data(),
-        static_cast<uint32_t>(alpn_buffers.size()),
-        &settings,
-        sizeof(settings),
-        nullptr,
-        &handle_);
+    QUIC_STATUS status;
+    {
+      // GIL を解放して MsQuic API を呼び出す
+      nb::gil_scoped_release release;
+      status = g_MsQuic->ConfigurationOpen(
+          registration.handle(),
+          alpn_buffers_.data(),
+          static_cast<uint32_t>(alpn_buffers_.size()),
+          &settings,
+          sizeof(settings),
+          nullptr,
+          &handle_);
+    }
     if (QUIC_FAILED(status)) {
-      throw std::runtime_error("Failed to open configuration");
+      throw QuicError("Failed to open configuration");
     }
   }
 
@@ -187,15 +263,15 @@ class Configuration {
 
   HQUIC handle() const { return handle_; }
 
-  void load_credential_file(const std::string& cert_file,
-                            const std::string& key_file,
-                            bool is_client = false) {
+  MSQUIC_PY_COLD void load_credential_file(const char* cert_file,
+                                           const char* key_file,
+                                           bool is_client = false) {
     QUIC_CREDENTIAL_CONFIG cred_config = {};
     cred_config.Type = QUIC_CREDENTIAL_TYPE_CERTIFICATE_FILE;
 
     QUIC_CERTIFICATE_FILE cert_file_config = {};
-    cert_file_config.CertificateFile = cert_file.c_str();
-    cert_file_config.PrivateKeyFile = key_file.c_str();
+    cert_file_config.CertificateFile = cert_file;
+    cert_file_config.PrivateKeyFile = key_file;
     cred_config.CertificateFile = &cert_file_config;
 
     if (is_client) {
@@ -204,13 +280,18 @@ class Configuration {
       cred_config.Flags = QUIC_CREDENTIAL_FLAG_NONE;
     }
 
-    QUIC_STATUS status = g_MsQuic->ConfigurationLoadCredential(handle_, &cred_config);
+    QUIC_STATUS status;
+    {
+      // GIL を解放して MsQuic API を呼び出す
+      nb::gil_scoped_release release;
+      status = g_MsQuic->ConfigurationLoadCredential(handle_, &cred_config);
+    }
     if (QUIC_FAILED(status)) {
-      throw std::runtime_error("Failed to load credential");
+      throw QuicError("Failed to load credential");
     }
   }
 
-  void load_credential_none(bool no_certificate_validation = false) {
+  MSQUIC_PY_COLD void load_credential_none(bool no_certificate_validation = false) {
     QUIC_CREDENTIAL_CONFIG cred_config = {};
     cred_config.Type = QUIC_CREDENTIAL_TYPE_NONE;
     cred_config.Flags = QUIC_CREDENTIAL_FLAG_CLIENT;
@@ -218,9 +299,14 @@ class Configuration {
       cred_config.Flags |= QUIC_CREDENTIAL_FLAG_NO_CERTIFICATE_VALIDATION;
     }
 
-    QUIC_STATUS status = g_MsQuic->ConfigurationLoadCredential(handle_, &cred_config);
+    QUIC_STATUS status;
+    {
+      // GIL を解放して MsQuic API を呼び出す
+      nb::gil_scoped_release release;
+      status = g_MsQuic->ConfigurationLoadCredential(handle_, &cred_config);
+    }
     if (QUIC_FAILED(status)) {
-      throw std::runtime_error("Failed to load credential");
+      throw QuicError("Failed to load credential");
     }
   }
 
@@ -235,31 +321,155 @@ class Configuration {
 
  private:
   HQUIC handle_ = nullptr;
+  // QUIC_BUFFER が指す文字列の実体 (ポインタを安定させるため保持する)
+  std::vector<std::string> alpn_storage_;
+  std::vector<QUIC_BUFFER> alpn_buffers_;
 };
 
+// ========== SendCtx ==========
+// 送信中の Python bytes オブジェクトを保持するコンテキスト
+// memcpy せずに bytes の内部バッファを直接 QUIC_BUFFER に渡し、
+// SEND_COMPLETE / DATAGRAM の最終状態で参照を解放する
+struct SendCtx {
+  // GIL 保持中に初期化・リセットすること (参照カウント操作のため)
+  std::vector<nb::object> keep_alive;
+  // bytes 以外 (bytearray / memoryview / NumPy 配列など) は
+  // バッファプロトコル経由で参照を保持する
+  std::vector<Py_buffer> views;
+  std::vector<QUIC_BUFFER> buffers;
+
+  void init(nb::handle data) {
+    keep_alive.reserve(1);
+    buffers.reserve(1);
+    append(data);
+  }
+
+  void init(const nb::list& payloads) {
+    size_t count = nb::len(payloads);
+    keep_alive.reserve(count);
+    buffers.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+      append(payloads[i]);
+    }
+  }
+
+  void reset() {
+    keep_alive.clear();
+    for (auto& view : views) {
+      PyBuffer_Release(&view);
+    }
+    views.clear();
+    buffers.clear();
+  }
+
+  void append(nb::handle data) {
+    QUIC_BUFFER buf;
+    if (PyBytes_CheckExact(data.ptr())) {
+      // bytes はバッファプロトコルを介さず直接参照する
+      buf.Length = static_cast<uint32_t>(PyBytes_GET_SIZE(data.ptr()));
+      buf.Buffer = (uint8_t*)PyBytes_AS_STRING(data.ptr());
+      keep_alive.push_back(nb::borrow(data));
+      buffers.push_back(buf);
+      return;
+    }
+    Py_buffer view;
+    if (PyObject_GetBuffer(data.ptr(), &view, PyBUF_SIMPLE) != 0) {
+      throw nb::python_error();
+    }
+    buf.Length = static_cast<uint32_t>(view.len);
+    buf.Buffer = (uint8_t*)view.buf;
+    views.push_back(view);
+    buffers.push_back(buf);
+  }
+};
+
+// SendCtx のフリーリスト
+// 送信ごとの new/delete を避けるため、解放済みインスタンスを再利用する
+// 取得は Python スレッド、返却は MsQuic ワーカースレッドで行われるため
+// スレッドローカルではなく mutex で保護したグローバルリストにする
+std::mutex g_SendCtxPoolMutex;
+std::vector<SendCtx*> g_SendCtxPool;
+constexpr size_t kSendCtxPoolLimit = 64;
+
+SendCtx* acquire_send_ctx() {
+  {
+    std::lock_guard<std::mutex> lock(g_SendCtxPoolMutex);
+    if (!g_SendCtxPool.empty()) {
+      SendCtx* ctx = g_SendCtxPool.back();
+      g_SendCtxPool.pop_back();
+      return ctx;
+    }
+  }
+  return new SendCtx();
+}
+
+void release_send_ctx(SendCtx* ctx) {
+  // GIL 保持中に呼ぶこと (bytes の参照解放のため)
+  ctx->reset();
+  {
+    std::lock_guard<std::mutex> lock(g_SendCtxPoolMutex);
+    if (g_SendCtxPool.size() < kSendCtxPoolLimit) {
+      g_SendCtxPool.push_back(ctx);
+      return;
+    }
+  }
+  delete ctx;
+}
+
+// 前方宣言
+struct ConnectionContext;
+struct ListenerContext;
+
 // ========== Stream ==========
 // Stream コールバック用のコンテキスト
 // 注意: mutex は使用しない。すべてのコールバック操作は GIL で保護される。
 // Python から呼ばれる set_on_* は GIL 保持中、
 // MsQuic からのコールバックは GIL を取得してからアクセスする。
 struct StreamContext {
+  // 短絡用のフラグ。実際の同期は MsQuic のイベント順序と GIL が
+  // 担うため relaxed ロードで読む
   std::atomic<bool> is_closing{false};
   HQUIC handle = nullptr;
-  std::function<void(const std::vector<uint8_t>&, bool)> on_receive;
-  std::function<void()> on_send_complete;
-  std::function<void(uint64_t)> on_peer_send_aborted;
-  std::function<void(uint64_t)> on_peer_receive_aborted;
-  std::function<void(bool)> on_shutdown_complete;
+  // この Stream を管理している親 Connection のコンテキスト
+  // SHUTDOWN_COMPLETE で streams から自分を削除するために使う
+  ConnectionContext* parent = nullptr;
+  // コールバックは std::function を介さず Python の呼び出し可能
+  // オブジェクトをそのまま保持する (型消去ラッパーのヒープ割り当てと
+  // 引数キャストを省くため)。最もホットな on_receive は vectorcall で呼ぶ
+  nb::object on_receive;
+  nb::object on_send_complete;
+  nb::object on_peer_send_aborted;
+  nb::object on_peer_receive_aborted;
+  nb::object on_shutdown_complete;
+  // 完了していない送信の数。送信時にインクリメントし、
+  // SEND_COMPLETE で GIL を取らずにデクリメントする
+  std::atomic<uint64_t> pending_sends{0};
+  // コールバック未設定時に GIL 取得をスキップするためのフラグ
+  // 書き込みは GIL 保持中のみ。コールバック本体の可視性は
+  // その後の GIL 取得が同期点になるため relaxed で十分
+  // RECEIVE にはフラグを置かない。start 後の set_on_receive を
+  // relaxed ロードで取りこぼすとデータを消費したまま配送されず
+  // 失われるため、RECEIVE は必ず GIL を取って実体を確認する
+  std::atomic<bool> has_on_peer_send_aborted{false};
+  std::atomic<bool> has_on_peer_receive_aborted{false};
+  // RECEIVE で QUIC_STATUS_PENDING を返し、受信完了の ACK を
+  // Python 側の receive_complete に委ねるかどうか
+  std::atomic<bool> manual_receive{false};
+  // PENDING を返した RECEIVE が未完了かどうかと、そのイベントの全長
+  // pending_receive_total は receive_pending の release/acquire で同期する
+  std::atomic<bool> receive_pending{false};
+  uint64_t pending_receive_total = 0;
 };
 
 // Stream コールバック（前方宣言）
-QUIC_STATUS QUIC_API StreamCallback(HQUIC stream, void* context, QUIC_STREAM_EVENT* event);
+MSQUIC_PY_HOT QUIC_STATUS QUIC_API StreamCallback(HQUIC stream,
+                                                  void* context,
+                                                  QUIC_STREAM_EVENT* event);
 
 class Stream {
  public:
   Stream(HQUIC handle) : handle_(handle) {
-    context_ = std::make_unique<StreamContext>();
-    context_->handle = handle;
+    context_.handle = handle;
   }
 
   ~Stream() {
@@ -268,136 +478,332 @@ class Stream {
   }
 
   HQUIC handle() const { return handle_; }
-  StreamContext* context() const { return context_.get(); }
+  StreamContext* context() { return &context_; }
+
+  // StreamOpen にコンテキストを渡して開く場合用
+  // ハンドル確定前にコールバックが来ることはない (StreamStart 前のため)
+  void attach_handle(HQUIC handle) {
+    handle_ = handle;
+    context_.handle = handle;
+  }
 
   void start(QUIC_STREAM_START_FLAGS flags = QUIC_STREAM_START_FLAG_NONE) {
-    QUIC_STATUS status = g_MsQuic->StreamStart(handle_, flags);
+    QUIC_STATUS status;
+    {
+      // GIL を解放して MsQuic API を呼び出す
+      nb::gil_scoped_release release;
+      status = g_MsQuic->StreamStart(handle_, flags);
+    }
     if (QUIC_FAILED(status)) {
-      throw std::runtime_error("Failed to start stream");
+      throw QuicError("Failed to start stream");
     }
   }
 
-  void send(const nb::bytes& data, QUIC_SEND_FLAGS flags = QUIC_SEND_FLAG_NONE) {
-    // データをコピーして保持
-    auto* buf_data = new uint8_t[data.size()];
-    std::memcpy(buf_data, data.c_str(), data.size());
+  void send(nb::object data, QUIC_SEND_FLAGS flags = QUIC_SEND_FLAG_NONE) {
+    // コピーせずペイロードへの参照を保持して内部バッファを直接渡す
+    // bytes のほか bytearray / memoryview などバッファプロトコルを
+    // 実装するオブジェクトをそのまま受け付ける
+    // GIL 保持中に初期化する (参照カウント操作のため)
+    auto* ctx = acquire_send_ctx();
+    try {
+      ctx->init(data);
+    } catch (...) {
+      release_send_ctx(ctx);
+      throw;
+    }
+
+    // SEND_COMPLETE が先に走っても負にならないよう、送信前に加算する
+    context_.pending_sends.fetch_add(1, std::memory_order_relaxed);
+    QUIC_STATUS status;
+    {
+      // GIL を解放して MsQuic API を呼び出す
+      nb::gil_scoped_release release;
+      status = g_MsQuic->StreamSend(handle_, ctx->buffers.data(), 1, flags, ctx);
+    }
+    if (QUIC_FAILED(status)) {
+      // GIL 保持中なのでそのまま返却できる
+      context_.pending_sends.fetch_sub(1, std::memory_order_relaxed);
+      release_send_ctx(ctx);
+      throw QuicError("Failed to send data");
+    }
+  }
 
-    auto* buffer = new QUIC_BUFFER;
-    buffer->Length = static_cast<uint32_t>(data.size());
-    buffer->Buffer = buf_data;
+  void send_many(const nb::list& payloads, QUIC_SEND_FLAGS flags = QUIC_SEND_FLAG_NONE) {
+    // 複数の bytes を 1 回の StreamSend にまとめて渡す
+    // UDP 層での GSO によるまとめ送信を期待できる
+    auto* ctx = acquire_send_ctx();
+    try {
+      ctx->init(payloads);
+    } catch (...) {
+      release_send_ctx(ctx);
+      throw;
+    }
 
+    // SEND_COMPLETE が先に走っても負にならないよう、送信前に加算する
+    context_.pending_sends.fetch_add(1, std::memory_order_relaxed);
     QUIC_STATUS status;
     {
       // GIL を解放して MsQuic API を呼び出す
       nb::gil_scoped_release release;
-      status = g_MsQuic->StreamSend(handle_, buffer, 1, flags, buffer);
+      status = g_MsQuic->StreamSend(handle_, ctx->buffers.data(),
+                                    static_cast<uint32_t>(ctx->buffers.size()), flags, ctx);
     }
     if (QUIC_FAILED(status)) {
-      delete[] buf_data;
-      delete buffer;
-      throw std::runtime_error("Failed to send data");
+      // GIL 保持中なのでそのまま返却できる
+      context_.pending_sends.fetch_sub(1, std::memory_order_relaxed);
+      release_send_ctx(ctx);
+      throw QuicError("Failed to send data");
     }
   }
 
   void shutdown(QUIC_STREAM_SHUTDOWN_FLAGS flags, uint64_t error_code = 0) {
-    QUIC_STATUS status = g_MsQuic->StreamShutdown(handle_, flags, error_code);
+    QUIC_STATUS status;
+    {
+      // GIL を解放して MsQuic API を呼び出す
+      nb::gil_scoped_release release;
+      status = g_MsQuic->StreamShutdown(handle_, flags, error_code);
+    }
     if (QUIC_FAILED(status)) {
-      throw std::runtime_error("Failed to shutdown stream");
+      throw QuicError("Failed to shutdown stream");
+    }
+  }
+
+  uint64_t pending_sends() const {
+    return context_.pending_sends.load(std::memory_order_relaxed);
+  }
+
+  void set_manual_receive(bool enabled) {
+    // 有効にすると RECEIVE ごとに受信ウィンドウが止まり、
+    // receive_complete で消費を通知するまで次の配送が来ない
+    // (Python 側からのバックプレッシャー)
+    context_.manual_receive.store(enabled, std::memory_order_relaxed);
+  }
+
+  void receive_complete() {
+    // RECEIVE はイベントの全バイトを bytes にして on_receive へ渡し済み
+    // のため、部分 ACK を許すと残りが再配送されて重複する
+    // PENDING 中のイベントを全長で完了することだけを許す
+    if (context_.is_closing.load(std::memory_order_acquire)) {
+      throw QuicError("Stream is already shut down");
     }
+    if (!context_.receive_pending.exchange(false, std::memory_order_acquire)) {
+      throw QuicError("No pending receive to complete");
+    }
+    uint64_t byte_count = context_.pending_receive_total;
+    // GIL を解放して MsQuic API を呼び出す
+    nb::gil_scoped_release release;
+    g_MsQuic->StreamReceiveComplete(handle_, byte_count);
   }
 
-  void set_on_receive(std::function<void(const std::vector<uint8_t>&, bool)> callback) {
+  void set_on_receive(nb::object callback) {
     // GIL 保持中に呼ばれる (Python から)
-    context_->on_receive = std::move(callback);
+    if (callback.is_none()) {
+      callback = nb::object();
+    }
+    context_.on_receive = std::move(callback);
   }
 
-  void set_on_send_complete(std::function<void()> callback) {
+  void set_on_send_complete(nb::object callback) {
     // GIL 保持中に呼ばれる (Python から)
-    context_->on_send_complete = std::move(callback);
+    if (callback.is_none()) {
+      callback = nb::object();
+    }
+    context_.on_send_complete = std::move(callback);
   }
 
-  void set_on_shutdown_complete(std::function<void(bool)> callback) {
+  void set_on_shutdown_complete(nb::object callback) {
     // GIL 保持中に呼ばれる (Python から)
-    context_->on_shutdown_complete = std::move(callback);
+    if (callback.is_none()) {
+      callback = nb::object();
+    }
+    context_.on_shutdown_complete = std::move(callback);
   }
 
  private:
   HQUIC handle_ = nullptr;
-  std::unique_ptr<StreamContext> context_;
+  // コールバックのホットパスで余計な間接参照とキャッシュミスを
+  // 避けるため、別ヒープではなくメンバーとして埋め込む
+  // make_shared<Stream> の 1 回の割り当てに含まれる
+  StreamContext context_;
+};
+
+// ========== Connection ==========
+// 注意: mutex は使用しない。すべてのコールバック操作は GIL で保護される。
+struct ConnectionContext {
+  std::atomic<bool> is_closing{false};
+  HQUIC handle = nullptr;
+  // この Connection を管理している親 Listener のコンテキスト
+  // SHUTDOWN_COMPLETE で connections から自分を削除するために使う
+  ListenerContext* parent = nullptr;
+  // コールバックは std::function を介さず Python の呼び出し可能
+  // オブジェクトをそのまま保持する
+  nb::object on_connected;
+  nb::object on_shutdown_complete;
+  nb::object on_peer_stream_started;
+  // ストリームを HQUIC で引けるように保持し、SHUTDOWN_COMPLETE で削除する
+  std::unordered_map<HQUIC, std::shared_ptr<Stream>> streams;
+  // DATAGRAM コールバック
+  nb::object on_datagram_state_changed;
+  nb::object on_datagram_received;
+  nb::object on_datagram_send_state_changed;
+  // Resumption コールバック
+  nb::object on_resumption_ticket_received;
+  nb::object on_resumed;
+  // コールバック未設定時に GIL 取得をスキップするためのフラグ
+  // 書き込みは GIL 保持中のみ。コールバック本体の可視性は
+  // その後の GIL 取得が同期点になるため relaxed で十分
+  std::atomic<bool> has_on_connected{false};
+  std::atomic<bool> has_on_datagram_state_changed{false};
+  std::atomic<bool> has_on_datagram_received{false};
+  std::atomic<bool> has_on_datagram_send_state_changed{false};
+  std::atomic<bool> has_on_resumption_ticket_received{false};
+  std::atomic<bool> has_on_resumed{false};
 };
 
 // Stream コールバック
-QUIC_STATUS QUIC_API StreamCallback(HQUIC stream, void* context, QUIC_STREAM_EVENT* event) {
+MSQUIC_PY_HOT QUIC_STATUS QUIC_API StreamCallback(HQUIC stream,
+                                                  void* context,
+                                                  QUIC_STREAM_EVENT* event) {
   auto* ctx = static_cast<StreamContext*>(context);
-  if (!ctx || ctx->is_closing.load()) {
+  if (!ctx || ctx->is_closing.load(std::memory_order_relaxed)) [[unlikely]] {
     return QUIC_STATUS_SUCCESS;
   }
 
   switch (event->Type) {
-    case QUIC_STREAM_EVENT_RECEIVE: {
-      // データを先にコピー (GIL 不要)
-      std::vector<uint8_t> data;
-      for (uint32_t i = 0; i < event->RECEIVE.BufferCount; i++) {
-        const auto& buf = event->RECEIVE.Buffers[i];
-        data.insert(data.end(), buf.Buffer, buf.Buffer + buf.Length);
-      }
+    case QUIC_STREAM_EVENT_RECEIVE: [[likely]] {
+      // 未設定フラグによる GIL スキップはしない。start 後に
+      // set_on_receive された場合に古い false を見てデータを消費して
+      // しまうと配送されずに失われるため、必ず GIL を取って
+      // 実体を確認する
       bool fin = (event->RECEIVE.Flags & QUIC_RECEIVE_FLAG_FIN) != 0;
 
       // GIL を取得してコールバックにアクセス
       nb::gil_scoped_acquire acquire;
       if (ctx->on_receive) {
-        ctx->on_receive(data, fin);
+        // PyBytes を 1 回だけ確保して各フラグメントを直接コピーする
+        // list[int] 変換 (バイトごとの PyLong 生成) を避けるため
+        // bytes として Python に渡す
+        // 合計サイズは MsQuic が TotalBufferLength で提供している
+        uint64_t total = event->RECEIVE.TotalBufferLength;
+        PyObject* obj = PyBytes_FromStringAndSize(nullptr, static_cast<Py_ssize_t>(total));
+        if (obj == nullptr) {
+          // コールバック外に例外を漏らさない (MsQuic の C コールバック内のため)
+          PyErr_Clear();
+          return QUIC_STATUS_OUT_OF_MEMORY;
+        }
+        char* dst = PyBytes_AS_STRING(obj);
+        size_t offset = 0;
+        for (uint32_t i = 0; i < event->RECEIVE.BufferCount; i++) {
+          const auto& buf = event->RECEIVE.Buffers[i];
+          std::memcpy(dst + offset, buf.Buffer, buf.Length);
+          offset += buf.Length;
+        }
+        // std::function と引数キャストを介さず vectorcall で直接呼び出す
+        PyObject* args[2] = {obj, fin ? Py_True : Py_False};
+        PyObject* result = PyObject_Vectorcall(ctx->on_receive.ptr(), args, 2, nullptr);
+        if (result == nullptr) {
+          // コールバック外に例外を漏らさない (MsQuic の C コールバック内のため)
+          PyErr_WriteUnraisable(ctx->on_receive.ptr());
+        } else {
+          Py_DECREF(result);
+        }
+        Py_DECREF(obj);
+
+        // 手動 ACK モードでは PENDING を返して受信ウィンドウを止める
+        // Python が receive_complete を呼ぶまで次の RECEIVE は来ない
+        if (ctx->manual_receive.load(std::memory_order_relaxed)) {
+          ctx->pending_receive_total = total;
+          ctx->receive_pending.store(true, std::memory_order_release);
+          return QUIC_STATUS_PENDING;
+        }
       }
       break;
     }
-    case QUIC_STREAM_EVENT_SEND_COMPLETE: {
-      // 送信バッファを解放
-      auto* buffer = static_cast<QUIC_BUFFER*>(event->SEND_COMPLETE.ClientContext);
-      if (buffer) {
-        delete[] buffer->Buffer;
-        delete buffer;
-      }
-      // GIL を取得してコールバックにアクセス
+    case QUIC_STREAM_EVENT_SEND_COMPLETE: [[likely]] {
+      // 送信中カウンタは GIL を取らずに先にデクリメントする
+      ctx->pending_sends.fetch_sub(1, std::memory_order_relaxed);
+      auto* send_ctx = static_cast<SendCtx*>(event->SEND_COMPLETE.ClientContext);
+      // GIL を取得して送信コンテキストの返却とコールバック呼び出しを行う
+      // (bytes の参照解放には GIL が必要)
       nb::gil_scoped_acquire acquire;
+      if (send_ctx) {
+        release_send_ctx(send_ctx);
+      }
       if (ctx->on_send_complete) {
-        ctx->on_send_complete();
+        try {
+          ctx->on_send_complete();
+        } catch (nb::python_error& error) {
+          // コールバック外に例外を漏らさない (MsQuic の C コールバック内のため)
+          error.discard_as_unraisable(ctx->on_send_complete.ptr());
+        }
       }
       break;
     }
     case QUIC_STREAM_EVENT_PEER_SEND_ABORTED: {
+      // コールバック未設定なら GIL を取得せずに抜ける
+      if (!ctx->has_on_peer_send_aborted.load(std::memory_order_relaxed)) {
+        break;
+      }
       uint64_t error_code = event->PEER_SEND_ABORTED.ErrorCode;
       // GIL を取得してコールバックにアクセス
       nb::gil_scoped_acquire acquire;
       if (ctx->on_peer_send_aborted) {
-        ctx->on_peer_send_aborted(error_code);
+        try {
+          ctx->on_peer_send_aborted(error_code);
+        } catch (nb::python_error& error) {
+          // コールバック外に例外を漏らさない (MsQuic の C コールバック内のため)
+          error.discard_as_unraisable(ctx->on_peer_send_aborted.ptr());
+        }
       }
       break;
     }
     case QUIC_STREAM_EVENT_PEER_RECEIVE_ABORTED: {
+      // コールバック未設定なら GIL を取得せずに抜ける
+      if (!ctx->has_on_peer_receive_aborted.load(std::memory_order_relaxed)) {
+        break;
+      }
       uint64_t error_code = event->PEER_RECEIVE_ABORTED.ErrorCode;
       // GIL を取得してコールバックにアクセス
       nb::gil_scoped_acquire acquire;
       if (ctx->on_peer_receive_aborted) {
-        ctx->on_peer_receive_aborted(error_code);
+        try {
+          ctx->on_peer_receive_aborted(error_code);
+        } catch (nb::python_error& error) {
+          // コールバック外に例外を漏らさない (MsQuic の C コールバック内のため)
+          error.discard_as_unraisable(ctx->on_peer_receive_aborted.ptr());
+        }
       }
       break;
     }
-    case QUIC_STREAM_EVENT_SHUTDOWN_COMPLETE: {
+    case QUIC_STREAM_EVENT_SHUTDOWN_COMPLETE: [[unlikely]] {
       // 先に is_closing をセットして、これ以降のコールバックをブロック
-      ctx->is_closing.store(true);
+      ctx->is_closing.store(true, std::memory_order_release);
 
       // GIL を取得してコールバックを呼び出し、その後クリア
       {
         nb::gil_scoped_acquire acquire;
         if (ctx->on_shutdown_complete) {
-          ctx->on_shutdown_complete(event->SHUTDOWN_COMPLETE.ConnectionShutdown);
+          try {
+            ctx->on_shutdown_complete(
+                static_cast<bool>(event->SHUTDOWN_COMPLETE.ConnectionShutdown));
+          } catch (nb::python_error& error) {
+            // コールバック外に例外を漏らさない (MsQuic の C コールバック内のため)
+            error.discard_as_unraisable(ctx->on_shutdown_complete.ptr());
+          }
         }
         // 循環参照を解消するためにコールバックをクリアする
-        ctx->on_receive = nullptr;
-        ctx->on_send_complete = nullptr;
-        ctx->on_peer_send_aborted = nullptr;
-        ctx->on_peer_receive_aborted = nullptr;
-        ctx->on_shutdown_complete = nullptr;
+        ctx->on_receive = nb::object();
+        ctx->on_send_complete = nb::object();
+        ctx->on_peer_send_aborted = nb::object();
+        ctx->on_peer_receive_aborted = nb::object();
+        ctx->on_shutdown_complete = nb::object();
+        // 親 Connection の管理テーブルから自分を削除する
+        // erase で Stream が破棄されることがあるため、これ以降 ctx に触れない
+        if (ctx->parent) {
+          ConnectionContext* parent = ctx->parent;
+          ctx->parent = nullptr;
+          parent->streams.erase(stream);
+        }
       }
       // MsQuic のパターン: SHUTDOWN_COMPLETE で StreamClose を呼び出す
       // AppCloseInProgress が true の場合、アプリが既に Close を呼んでいるのでスキップ
@@ -412,47 +818,39 @@ QUIC_STATUS QUIC_API StreamCallback(HQUIC stream, void* context, QUIC_STREAM_EVE
   return QUIC_STATUS_SUCCESS;
 }
 
-// ========== Connection ==========
-// 注意: mutex は使用しない。すべてのコールバック操作は GIL で保護される。
-struct ConnectionContext {
-  std::atomic<bool> is_closing{false};
-  HQUIC handle = nullptr;
-  std::function<void(bool)> on_connected;
-  std::function<void(bool)> on_shutdown_complete;
-  std::function<void(std::shared_ptr<Stream>)> on_peer_stream_started;
-  std::vector<std::shared_ptr<Stream>> streams;
-  // DATAGRAM コールバック
-  std::function<void(bool, uint16_t)> on_datagram_state_changed;
-  std::function<void(const std::vector<uint8_t>&)> on_datagram_received;
-  std::function<void(QUIC_DATAGRAM_SEND_STATE)> on_datagram_send_state_changed;
-  // Resumption コールバック
-  std::function<void(const std::vector<uint8_t>&)> on_resumption_ticket_received;
-  std::function<void(const std::vector<uint8_t>&)> on_resumed;
-};
-
 // Connection コールバック（前方宣言）
-QUIC_STATUS QUIC_API ConnectionCallback(HQUIC connection, void* context, QUIC_CONNECTION_EVENT* event);
+MSQUIC_PY_HOT QUIC_STATUS QUIC_API
+ConnectionCallback(HQUIC connection,
+                   void* context,
+                   QUIC_CONNECTION_EVENT* event);
 
 class Connection {
  public:
   Connection(Registration& registration) : registration_(&registration) {
-    context_ = std::make_unique<ConnectionContext>();
-    QUIC_STATUS status = g_MsQuic->ConnectionOpen(
-        registration.handle(),
-        ConnectionCallback,
-        context_.get(),
-        &handle_);
+    // 初期のリハッシュを避けるため先に確保しておく
+    context_.streams.reserve(16);
+    QUIC_STATUS status;
+    {
+      // GIL を解放して MsQuic API を呼び出す
+      nb::gil_scoped_release release;
+      status = g_MsQuic->ConnectionOpen(
+          registration.handle(),
+          ConnectionCallback,
+          &context_,
+          &handle_);
+    }
     if (QUIC_FAILED(status)) {
-      throw std::runtime_error("Failed to open connection");
+      throw QuicError("Failed to open connection");
     }
-    context_->handle = handle_;
+    context_.handle = handle_;
   }
 
   // サーバー側から受け入れた接続用
   Connection(HQUIC handle) : handle_(handle), registration_(nullptr) {
-    context_ = std::make_unique<ConnectionContext>();
-    context_->handle = handle;
-    g_MsQuic->SetCallbackHandler(handle_, (void*)ConnectionCallback, context_.get());
+    // 初期のリハッシュを避けるため先に確保しておく
+    context_.streams.reserve(16);
+    context_.handle = handle;
+    g_MsQuic->SetCallbackHandler(handle_, (void*)ConnectionCallback, &context_);
   }
 
   ~Connection() {
@@ -461,110 +859,171 @@ class Connection {
   }
 
   HQUIC handle() const { return handle_; }
-  ConnectionContext* context() const { return context_.get(); }
-
-  void start(Configuration& config, const std::string& server_name, uint16_t port) {
-    QUIC_STATUS status = g_MsQuic->ConnectionStart(
-        handle_,
-        config.handle(),
-        QUIC_ADDRESS_FAMILY_UNSPEC,
-        server_name.c_str(),
-        port);
+  ConnectionContext* context() { return &context_; }
+
+  void start(Configuration& config, const char* server_name, uint16_t port) {
+    QUIC_STATUS status;
+    {
+      // GIL を解放して MsQuic API を呼び出す
+      nb::gil_scoped_release release;
+      status = g_MsQuic->ConnectionStart(
+          handle_,
+          config.handle(),
+          QUIC_ADDRESS_FAMILY_UNSPEC,
+          server_name,
+          port);
+    }
     if (QUIC_FAILED(status)) {
-      throw std::runtime_error("Failed to start connection");
+      throw QuicError("Failed to start connection");
     }
   }
 
   void set_configuration(Configuration& config) {
-    QUIC_STATUS status = g_MsQuic->ConnectionSetConfiguration(handle_, config.handle());
+    QUIC_STATUS status;
+    {
+      // GIL を解放して MsQuic API を呼び出す
+      nb::gil_scoped_release release;
+      status = g_MsQuic->ConnectionSetConfiguration(handle_, config.handle());
+    }
     if (QUIC_FAILED(status)) {
-      throw std::runtime_error("Failed to set configuration");
+      throw QuicError("Failed to set configuration");
     }
   }
 
   void shutdown(QUIC_CONNECTION_SHUTDOWN_FLAGS flags, uint64_t error_code) {
+    // GIL を解放して MsQuic API を呼び出す
+    nb::gil_scoped_release release;
     g_MsQuic->ConnectionShutdown(handle_, flags, error_code);
   }
 
   std::shared_ptr<Stream> open_stream(QUIC_STREAM_OPEN_FLAGS flags = QUIC_STREAM_OPEN_FLAG_NONE) {
+    // 先に Stream を生成し、StreamOpen にコンテキストを直接渡す
+    // (後から SetCallbackHandler で往復するコストを省く)
+    // コールバックは StreamStart までは来ないため、ハンドル未設定の
+    // 時間があっても問題ない
+    auto stream = std::make_shared<Stream>(nullptr);
+    stream->context()->parent = &context_;
     HQUIC stream_handle = nullptr;
-    QUIC_STATUS status = g_MsQuic->StreamOpen(
-        handle_,
-        flags,
-        StreamCallback,
-        nullptr,
-        &stream_handle);
+    QUIC_STATUS status;
+    {
+      // GIL を解放して MsQuic API を呼び出す
+      nb::gil_scoped_release release;
+      status = g_MsQuic->StreamOpen(
+          handle_,
+          flags,
+          StreamCallback,
+          stream->context(),
+          &stream_handle);
+    }
     if (QUIC_FAILED(status)) {
-      throw std::runtime_error("Failed to open stream");
+      throw QuicError("Failed to open stream");
     }
-    auto stream = std::make_shared<Stream>(stream_handle);
-    // コールバックのコンテキストを設定
-    g_MsQuic->SetCallbackHandler(stream_handle, (void*)StreamCallback, stream->context());
+    stream->attach_handle(stream_handle);
     // GIL 保持中に呼ばれる (Python から)
-    context_->streams.push_back(stream);
+    context_.streams.emplace(stream_handle, stream);
     return stream;
   }
 
-  void set_on_connected(std::function<void(bool)> callback) {
+  void set_on_connected(nb::object callback) {
     // GIL 保持中に呼ばれる (Python から)
-    context_->on_connected = std::move(callback);
+    if (callback.is_none()) {
+      callback = nb::object();
+    }
+    context_.on_connected = std::move(callback);
+    context_.has_on_connected.store(
+        static_cast<bool>(context_.on_connected),
+        std::memory_order_relaxed);
   }
 
-  void set_on_shutdown_complete(std::function<void(bool)> callback) {
+  void set_on_shutdown_complete(nb::object callback) {
     // GIL 保持中に呼ばれる (Python から)
-    context_->on_shutdown_complete = std::move(callback);
+    if (callback.is_none()) {
+      callback = nb::object();
+    }
+    context_.on_shutdown_complete = std::move(callback);
   }
 
-  void set_on_peer_stream_started(std::function<void(std::shared_ptr<Stream>)> callback) {
+  void set_on_peer_stream_started(nb::object callback) {
     // GIL 保持中に呼ばれる (Python から)
-    context_->on_peer_stream_started = std::move(callback);
+    if (callback.is_none()) {
+      callback = nb::object();
+    }
+    context_.on_peer_stream_started = std::move(callback);
   }
 
   // DATAGRAM メソッド
-  void send_datagram(const nb::bytes& data, QUIC_SEND_FLAGS flags = QUIC_SEND_FLAG_NONE) {
-    auto* buf_data = new uint8_t[data.size()];
-    std::memcpy(buf_data, data.c_str(), data.size());
-
-    auto* buffer = new QUIC_BUFFER;
-    buffer->Length = static_cast<uint32_t>(data.size());
-    buffer->Buffer = buf_data;
+  void send_datagram(nb::object data, QUIC_SEND_FLAGS flags = QUIC_SEND_FLAG_NONE) {
+    // コピーせずペイロードへの参照を保持して内部バッファを直接渡す
+    // bytes のほか bytearray / memoryview などバッファプロトコルを
+    // 実装するオブジェクトをそのまま受け付ける
+    // GIL 保持中に初期化する (参照カウント操作のため)
+    auto* ctx = acquire_send_ctx();
+    try {
+      ctx->init(data);
+    } catch (...) {
+      release_send_ctx(ctx);
+      throw;
+    }
 
     QUIC_STATUS status;
     {
       nb::gil_scoped_release release;
-      status = g_MsQuic->DatagramSend(handle_, buffer, 1, flags, buffer);
+      status = g_MsQuic->DatagramSend(handle_, ctx->buffers.data(), 1, flags, ctx);
     }
     if (QUIC_FAILED(status)) {
-      delete[] buf_data;
-      delete buffer;
-      throw std::runtime_error("Failed to send datagram");
+      // GIL 保持中なのでそのまま返却できる
+      release_send_ctx(ctx);
+      throw QuicError("Failed to send datagram");
     }
   }
 
-  void set_on_datagram_state_changed(std::function<void(bool, uint16_t)> callback) {
+  void set_on_datagram_state_changed(nb::object callback) {
     // GIL 保持中に呼ばれる (Python から)
-    context_->on_datagram_state_changed = std::move(callback);
+    if (callback.is_none()) {
+      callback = nb::object();
+    }
+    context_.on_datagram_state_changed = std::move(callback);
+    context_.has_on_datagram_state_changed.store(
+        static_cast<bool>(context_.on_datagram_state_changed),
+        std::memory_order_relaxed);
   }
 
-  void set_on_datagram_received(std::function<void(const std::vector<uint8_t>&)> callback) {
+  void set_on_datagram_received(nb::object callback) {
     // GIL 保持中に呼ばれる (Python から)
-    context_->on_datagram_received = std::move(callback);
+    if (callback.is_none()) {
+      callback = nb::object();
+    }
+    context_.on_datagram_received = std::move(callback);
+    context_.has_on_datagram_received.store(
+        static_cast<bool>(context_.on_datagram_received),
+        std::memory_order_relaxed);
   }
 
-  void set_on_datagram_send_state_changed(std::function<void(QUIC_DATAGRAM_SEND_STATE)> callback) {
+  void set_on_datagram_send_state_changed(nb::object callback) {
     // GIL 保持中に呼ばれる (Python から)
-    context_->on_datagram_send_state_changed = std::move(callback);
+    if (callback.is_none()) {
+      callback = nb::object();
+    }
+    context_.on_datagram_send_state_changed = std::move(callback);
+    context_.has_on_datagram_send_state_changed.store(
+        static_cast<bool>(context_.on_datagram_send_state_changed),
+        std::memory_order_relaxed);
   }
 
   // Resumption メソッド (サーバー側)
   void send_resumption_ticket(QUIC_SEND_RESUMPTION_FLAGS flags = QUIC_SEND_RESUMPTION_FLAG_NONE) {
-    QUIC_STATUS status = g_MsQuic->ConnectionSendResumptionTicket(
-        handle_,
-        flags,
-        0,
-        nullptr);
+    QUIC_STATUS status;
+    {
+      // GIL を解放して MsQuic API を呼び出す
+      nb::gil_scoped_release release;
+      status = g_MsQuic->ConnectionSendResumptionTicket(
+          handle_,
+          flags,
+          0,
+          nullptr);
+    }
     if (QUIC_FAILED(status)) {
-      throw std::runtime_error("Failed to send resumption ticket");
+      throw QuicError("Failed to send resumption ticket");
     }
   }
 
@@ -585,62 +1044,118 @@ class Connection {
           ticket_data.data());
     }
     if (QUIC_FAILED(status)) {
-      throw std::runtime_error("Failed to set resumption ticket");
+      throw QuicError("Failed to set resumption ticket");
     }
   }
 
-  void set_on_resumption_ticket_received(std::function<void(const std::vector<uint8_t>&)> callback) {
+  void set_on_resumption_ticket_received(nb::object callback) {
     // GIL 保持中に呼ばれる (Python から)
-    context_->on_resumption_ticket_received = std::move(callback);
+    if (callback.is_none()) {
+      callback = nb::object();
+    }
+    context_.on_resumption_ticket_received = std::move(callback);
+    context_.has_on_resumption_ticket_received.store(
+        static_cast<bool>(context_.on_resumption_ticket_received),
+        std::memory_order_relaxed);
   }
 
-  void set_on_resumed(std::function<void(const std::vector<uint8_t>&)> callback) {
+  void set_on_resumed(nb::object callback) {
     // GIL 保持中に呼ばれる (Python から)
-    context_->on_resumed = std::move(callback);
+    if (callback.is_none()) {
+      callback = nb::object();
+    }
+    context_.on_resumed = std::move(callback);
+    context_.has_on_resumed.store(
+        static_cast<bool>(context_.on_resumed),
+        std::memory_order_relaxed);
   }
 
  private:
   HQUIC handle_ = nullptr;
   Registration* registration_;
-  std::unique_ptr<ConnectionContext> context_;
+  // コールバックのホットパスで余計な間接参照とキャッシュミスを
+  // 避けるため、別ヒープではなくメンバーとして埋め込む
+  ConnectionContext context_;
 };
 
-QUIC_STATUS QUIC_API ConnectionCallback(HQUIC connection, void* context, QUIC_CONNECTION_EVENT* event) {
+// ========== Listener ==========
+// 注意: mutex は使用しない。すべてのコールバック操作は GIL で保護される。
+struct ListenerContext {
+  std::atomic<bool> is_closing{false};
+  HQUIC handle = nullptr;
+  // コールバックは std::function を介さず Python の呼び出し可能
+  // オブジェクトをそのまま保持する
+  nb::object on_new_connection;
+  Configuration* config = nullptr;
+  // 接続を HQUIC で引けるように保持し、SHUTDOWN_COMPLETE で削除する
+  std::unordered_map<HQUIC, std::shared_ptr<Connection>> connections;
+};
+
+MSQUIC_PY_HOT QUIC_STATUS QUIC_API
+ConnectionCallback(HQUIC connection,
+                   void* context,
+                   QUIC_CONNECTION_EVENT* event) {
   auto* ctx = static_cast<ConnectionContext*>(context);
-  if (!ctx || ctx->is_closing.load()) {
+  if (!ctx || ctx->is_closing.load(std::memory_order_relaxed)) [[unlikely]] {
     return QUIC_STATUS_SUCCESS;
   }
 
   switch (event->Type) {
     case QUIC_CONNECTION_EVENT_CONNECTED: {
+      // コールバック未設定なら GIL を取得せずに抜ける
+      if (!ctx->has_on_connected.load(std::memory_order_relaxed)) {
+        break;
+      }
       bool session_resumed = event->CONNECTED.SessionResumed != 0;
       // GIL を取得してコールバックにアクセス
       nb::gil_scoped_acquire acquire;
       if (ctx->on_connected) {
-        ctx->on_connected(session_resumed);
+        try {
+          ctx->on_connected(session_resumed);
+        } catch (nb::python_error& error) {
+          // コールバック外に例外を漏らさない (MsQuic の C コールバック内のため)
+          error.discard_as_unraisable(ctx->on_connected.ptr());
+        }
       }
       break;
     }
-    case QUIC_CONNECTION_EVENT_SHUTDOWN_COMPLETE: {
+    case QUIC_CONNECTION_EVENT_SHUTDOWN_COMPLETE: [[unlikely]] {
       // 先に is_closing をセットして、これ以降のコールバックをブロック
-      ctx->is_closing.store(true);
+      ctx->is_closing.store(true, std::memory_order_release);
 
       // GIL を取得してコールバックを呼び出し、その後クリア
       {
         nb::gil_scoped_acquire acquire;
         if (ctx->on_shutdown_complete) {
-          ctx->on_shutdown_complete(event->SHUTDOWN_COMPLETE.AppCloseInProgress);
+          try {
+            ctx->on_shutdown_complete(
+                static_cast<bool>(event->SHUTDOWN_COMPLETE.AppCloseInProgress));
+          } catch (nb::python_error& error) {
+            // コールバック外に例外を漏らさない (MsQuic の C コールバック内のため)
+            error.discard_as_unraisable(ctx->on_shutdown_complete.ptr());
+          }
         }
         // 循環参照を解消するためにコールバックと streams をクリアする
-        ctx->on_connected = nullptr;
-        ctx->on_shutdown_complete = nullptr;
-        ctx->on_peer_stream_started = nullptr;
-        ctx->on_datagram_state_changed = nullptr;
-        ctx->on_datagram_received = nullptr;
-        ctx->on_datagram_send_state_changed = nullptr;
-        ctx->on_resumption_ticket_received = nullptr;
-        ctx->on_resumed = nullptr;
+        ctx->on_connected = nb::object();
+        ctx->on_shutdown_complete = nb::object();
+        ctx->on_peer_stream_started = nb::object();
+        ctx->on_datagram_state_changed = nb::object();
+        ctx->on_datagram_received = nb::object();
+        ctx->on_datagram_send_state_changed = nb::object();
+        ctx->on_resumption_ticket_received = nb::object();
+        ctx->on_resumed = nb::object();
+        // 残っているストリームの親参照を外してからクリアする
+        for (auto& entry : ctx->streams) {
+          entry.second->context()->parent = nullptr;
+        }
         ctx->streams.clear();
+        // 親 Listener の管理テーブルから自分を削除する
+        // erase で Connection が破棄されることがあるため、これ以降 ctx に触れない
+        if (ctx->parent) {
+          ListenerContext* parent = ctx->parent;
+          ctx->parent = nullptr;
+          parent->connections.erase(connection);
+        }
       }
       // MsQuic のパターン: SHUTDOWN_COMPLETE で ConnectionClose を呼び出す
       // AppCloseInProgress が true の場合、アプリが既に Close を呼んでいるのでスキップ
@@ -652,6 +1167,7 @@ QUIC_STATUS QUIC_API ConnectionCallback(HQUIC connection, void* context, QUIC_CO
     case QUIC_CONNECTION_EVENT_PEER_STREAM_STARTED: {
       // Stream オブジェクトを作成
       auto stream = std::make_shared<Stream>(event->PEER_STREAM_STARTED.Stream);
+      stream->context()->parent = ctx;
 
       // GIL を取得してコールバックにアクセス
       // 先に Python コールバックを呼んで on_receive を設定させる
@@ -659,9 +1175,14 @@ QUIC_STATUS QUIC_API ConnectionCallback(HQUIC connection, void* context, QUIC_CO
       // on_receive が未設定でデータが失われる
       {
         nb::gil_scoped_acquire acquire;
-        ctx->streams.push_back(stream);
+        ctx->streams.emplace(event->PEER_STREAM_STARTED.Stream, stream);
         if (ctx->on_peer_stream_started) {
-          ctx->on_peer_stream_started(stream);
+          try {
+            ctx->on_peer_stream_started(stream);
+          } catch (nb::python_error& error) {
+            // コールバック外に例外を漏らさない (MsQuic の C コールバック内のため)
+            error.discard_as_unraisable(ctx->on_peer_stream_started.ptr());
+          }
         }
       }
 
@@ -673,69 +1194,110 @@ QUIC_STATUS QUIC_API ConnectionCallback(HQUIC connection, void* context, QUIC_CO
       break;
     }
     case QUIC_CONNECTION_EVENT_DATAGRAM_STATE_CHANGED: {
+      // コールバック未設定なら GIL を取得せずに抜ける
+      if (!ctx->has_on_datagram_state_changed.load(std::memory_order_relaxed)) {
+        break;
+      }
       bool send_enabled = event->DATAGRAM_STATE_CHANGED.SendEnabled != 0;
       uint16_t max_send_length = event->DATAGRAM_STATE_CHANGED.MaxSendLength;
       // GIL を取得してコールバックにアクセス
       nb::gil_scoped_acquire acquire;
       if (ctx->on_datagram_state_changed) {
-        ctx->on_datagram_state_changed(send_enabled, max_send_length);
+        try {
+          ctx->on_datagram_state_changed(send_enabled, max_send_length);
+        } catch (nb::python_error& error) {
+          // コールバック外に例外を漏らさない (MsQuic の C コールバック内のため)
+          error.discard_as_unraisable(ctx->on_datagram_state_changed.ptr());
+        }
       }
       break;
     }
-    case QUIC_CONNECTION_EVENT_DATAGRAM_RECEIVED: {
-      // データを先にコピー (GIL 不要)
-      std::vector<uint8_t> data(
-          event->DATAGRAM_RECEIVED.Buffer->Buffer,
-          event->DATAGRAM_RECEIVED.Buffer->Buffer + event->DATAGRAM_RECEIVED.Buffer->Length);
+    case QUIC_CONNECTION_EVENT_DATAGRAM_RECEIVED: [[likely]] {
+      // コールバック未設定なら GIL を取得せずに抜ける
+      if (!ctx->has_on_datagram_received.load(std::memory_order_relaxed)) {
+        break;
+      }
       // GIL を取得してコールバックにアクセス
+      // バッファはコールバック中は有効なので、中間の vector を介さず
+      // bytes を直接構築する (list[int] 変換による PyLong 生成も避ける)
       nb::gil_scoped_acquire acquire;
       if (ctx->on_datagram_received) {
-        ctx->on_datagram_received(data);
+        nb::bytes data(reinterpret_cast<const char*>(event->DATAGRAM_RECEIVED.Buffer->Buffer),
+                       event->DATAGRAM_RECEIVED.Buffer->Length);
+        try {
+          ctx->on_datagram_received(data);
+        } catch (nb::python_error& error) {
+          // コールバック外に例外を漏らさない (MsQuic の C コールバック内のため)
+          error.discard_as_unraisable(ctx->on_datagram_received.ptr());
+        }
       }
       break;
     }
     case QUIC_CONNECTION_EVENT_DATAGRAM_SEND_STATE_CHANGED: {
       QUIC_DATAGRAM_SEND_STATE state = event->DATAGRAM_SEND_STATE_CHANGED.State;
       void* client_context = event->DATAGRAM_SEND_STATE_CHANGED.ClientContext;
-      // GIL を取得してコールバックにアクセス
-      {
-        nb::gil_scoped_acquire acquire;
-        if (ctx->on_datagram_send_state_changed) {
+      // コールバック未設定かつ解放対象もないなら GIL を取得せずに抜ける
+      if (!ctx->has_on_datagram_send_state_changed.load(std::memory_order_relaxed) &&
+          !(QUIC_DATAGRAM_SEND_STATE_IS_FINAL(state) && client_context)) {
+        break;
+      }
+      // GIL を取得してコールバック呼び出しと送信コンテキストの解放を行う
+      // (bytes の参照解放には GIL が必要)
+      nb::gil_scoped_acquire acquire;
+      if (ctx->on_datagram_send_state_changed) {
+        try {
           ctx->on_datagram_send_state_changed(state);
+        } catch (nb::python_error& error) {
+          // コールバック外に例外を漏らさない (MsQuic の C コールバック内のため)
+          error.discard_as_unraisable(ctx->on_datagram_send_state_changed.ptr());
         }
       }
-      // 送信バッファを解放（最終状態の場合）
-      if (QUIC_DATAGRAM_SEND_STATE_IS_FINAL(state)) {
-        auto* buffer = static_cast<QUIC_BUFFER*>(client_context);
-        if (buffer) {
-          delete[] buffer->Buffer;
-          delete buffer;
-        }
+      // 送信コンテキストを返却（最終状態の場合）
+      if (QUIC_DATAGRAM_SEND_STATE_IS_FINAL(state) && client_context) {
+        release_send_ctx(static_cast<SendCtx*>(client_context));
       }
       break;
     }
     case QUIC_CONNECTION_EVENT_RESUMPTION_TICKET_RECEIVED: {
-      // データを先にコピー (GIL 不要)
-      std::vector<uint8_t> ticket(
-          event->RESUMPTION_TICKET_RECEIVED.ResumptionTicket,
-          event->RESUMPTION_TICKET_RECEIVED.ResumptionTicket +
-              event->RESUMPTION_TICKET_RECEIVED.ResumptionTicketLength);
+      // コールバック未設定なら GIL を取得せずに抜ける
+      if (!ctx->has_on_resumption_ticket_received.load(std::memory_order_relaxed)) {
+        break;
+      }
       // GIL を取得してコールバックにアクセス
+      // バッファはコールバック中は有効なので、中間の vector を介さず
+      // bytes を直接構築する
       nb::gil_scoped_acquire acquire;
       if (ctx->on_resumption_ticket_received) {
-        ctx->on_resumption_ticket_received(ticket);
+        nb::bytes ticket(
+            reinterpret_cast<const char*>(event->RESUMPTION_TICKET_RECEIVED.ResumptionTicket),
+            event->RESUMPTION_TICKET_RECEIVED.ResumptionTicketLength);
+        try {
+          ctx->on_resumption_ticket_received(ticket);
+        } catch (nb::python_error& error) {
+          // コールバック外に例外を漏らさない (MsQuic の C コールバック内のため)
+          error.discard_as_unraisable(ctx->on_resumption_ticket_received.ptr());
+        }
       }
       break;
     }
     case QUIC_CONNECTION_EVENT_RESUMED: {
-      // データを先にコピー (GIL 不要)
-      std::vector<uint8_t> resumption_state(
-          event->RESUMED.ResumptionState,
-          event->RESUMED.ResumptionState + event->RESUMED.ResumptionStateLength);
+      // コールバック未設定なら GIL を取得せずに抜ける
+      if (!ctx->has_on_resumed.load(std::memory_order_relaxed)) {
+        break;
+      }
       // GIL を取得してコールバックにアクセス
+      // バッファはコールバック中は有効なので、中間の vector を介さず
+      // bytes を直接構築する
       nb::gil_scoped_acquire acquire;
       if (ctx->on_resumed) {
-        ctx->on_resumed(resumption_state);
+        nb::bytes resumption_state(reinterpret_cast<const char*>(event->RESUMED.ResumptionState),
+                                   event->RESUMED.ResumptionStateLength);
+        try {
+          ctx->on_resumed(resumption_state);
+        } catch (nb::python_error& error) {
+          // コールバック外に例外を漏らさない (MsQuic の C コールバック内のため)
+          error.discard_as_unraisable(ctx->on_resumed.ptr());
+        }
       }
       break;
     }
@@ -745,67 +1307,63 @@ QUIC_STATUS QUIC_API ConnectionCallback(HQUIC connection, void* context, QUIC_CO
   return QUIC_STATUS_SUCCESS;
 }
 
-// ========== Listener ==========
-// 注意: mutex は使用しない。すべてのコールバック操作は GIL で保護される。
-struct ListenerContext {
-  std::atomic<bool> is_closing{false};
-  HQUIC handle = nullptr;
-  std::function<void(std::shared_ptr<Connection>)> on_new_connection;
-  Configuration* config = nullptr;
-  std::vector<std::shared_ptr<Connection>> connections;
-};
-
 // Listener コールバック（前方宣言）
 QUIC_STATUS QUIC_API ListenerCallback(HQUIC listener, void* context, QUIC_LISTENER_EVENT* event);
+// (Listener はコネクション確立時のみ通るためホット指定はしない)
 
 class Listener {
  public:
   Listener(Registration& registration) {
-    context_ = std::make_unique<ListenerContext>();
-    QUIC_STATUS status = g_MsQuic->ListenerOpen(
-        registration.handle(),
-        ListenerCallback,
-        context_.get(),
-        &handle_);
+    // 初期のリハッシュを避けるため先に確保しておく
+    context_.connections.reserve(16);
+    QUIC_STATUS status;
+    {
+      // GIL を解放して MsQuic API を呼び出す
+      nb::gil_scoped_release release;
+      status = g_MsQuic->ListenerOpen(
+          registration.handle(),
+          ListenerCallback,
+          &context_,
+          &handle_);
+    }
     if (QUIC_FAILED(status)) {
-      throw std::runtime_error("Failed to open listener");
+      throw QuicError("Failed to open listener");
     }
-    context_->handle = handle_;
+    context_.handle = handle_;
   }
 
   ~Listener() {
     close();
   }
 
-  void start(Configuration& config, const std::vector<std::string>& alpn_list, uint16_t port) {
-    context_->config = &config;
+  void start(Configuration& config, nb::sequence alpn_list, uint16_t port) {
+    context_.config = &config;
 
-    // ALPN バッファを構築
-    alpn_buffers_.clear();
-    for (const auto& alpn : alpn_list) {
-      QUIC_BUFFER buf;
-      buf.Length = static_cast<uint32_t>(alpn.size());
-      buf.Buffer = (uint8_t*)alpn.data();
-      alpn_buffers_.push_back(buf);
-    }
+    // ALPN バッファを一度だけ構築してメンバーに保持する
+    build_alpn_buffers(alpn_list, alpn_storage_, alpn_buffers_);
 
     QUIC_ADDR addr = {0};
     QuicAddrSetFamily(&addr, QUIC_ADDRESS_FAMILY_UNSPEC);
     QuicAddrSetPort(&addr, port);
 
-    QUIC_STATUS status = g_MsQuic->ListenerStart(
-        handle_,
-        alpn_buffers_.data(),
-        static_cast<uint32_t>(alpn_buffers_.size()),
-        &addr);
+    QUIC_STATUS status;
+    {
+      // GIL を解放して MsQuic API を呼び出す
+      nb::gil_scoped_release release;
+      status = g_MsQuic->ListenerStart(
+          handle_,
+          alpn_buffers_.data(),
+          static_cast<uint32_t>(alpn_buffers_.size()),
+          &addr);
+    }
     if (QUIC_FAILED(status)) {
-      throw std::runtime_error("Failed to start listener");
+      throw QuicError("Failed to start listener");
     }
   }
 
   void stop() {
     if (handle_ != nullptr && g_MsQuic != nullptr) {
-      context_->is_closing.store(true);
+      context_.is_closing.store(true, std::memory_order_release);
       // GIL を解放して MsQuic API を呼び出す
       nb::gil_scoped_release release;
       g_MsQuic->ListenerStop(handle_);
@@ -814,7 +1372,7 @@ class Listener {
 
   void close() {
     if (handle_ != nullptr && g_MsQuic != nullptr) {
-      context_->is_closing.store(true);
+      context_.is_closing.store(true, std::memory_order_release);
       // GIL を解放して MsQuic API を呼び出す
       nb::gil_scoped_release release;
       g_MsQuic->ListenerClose(handle_);
@@ -822,20 +1380,26 @@ class Listener {
     }
   }
 
-  void set_on_new_connection(std::function<void(std::shared_ptr<Connection>)> callback) {
+  void set_on_new_connection(nb::object callback) {
     // GIL 保持中に呼ばれる (Python から)
-    context_->on_new_connection = std::move(callback);
+    if (callback.is_none()) {
+      callback = nb::object();
+    }
+    context_.on_new_connection = std::move(callback);
   }
 
  private:
   HQUIC handle_ = nullptr;
-  std::unique_ptr<ListenerContext> context_;
+  // コールバック用コンテキストはメンバーとして埋め込む
+  ListenerContext context_;
+  // QUIC_BUFFER が指す文字列の実体 (ポインタを安定させるため保持する)
+  std::vector<std::string> alpn_storage_;
   std::vector<QUIC_BUFFER> alpn_buffers_;
 };
 
 QUIC_STATUS QUIC_API ListenerCallback(HQUIC listener, void* context, QUIC_LISTENER_EVENT* event) {
   auto* ctx = static_cast<ListenerContext*>(context);
-  if (!ctx || ctx->is_closing.load()) {
+  if (!ctx || ctx->is_closing.load(std::memory_order_relaxed)) [[unlikely]] {
     return QUIC_STATUS_SUCCESS;
   }
 
@@ -856,18 +1420,28 @@ QUIC_STATUS QUIC_API ListenerCallback(HQUIC listener, void* context, QUIC_LISTEN
 
       // GIL を取得してコールバックにアクセス
       nb::gil_scoped_acquire acquire;
-      ctx->connections.push_back(connection);
+      connection->context()->parent = ctx;
+      ctx->connections.emplace(event->NEW_CONNECTION.Connection, connection);
       if (ctx->on_new_connection) {
-        ctx->on_new_connection(connection);
+        try {
+          ctx->on_new_connection(connection);
+        } catch (nb::python_error& error) {
+          // コールバック外に例外を漏らさない (MsQuic の C コールバック内のため)
+          error.discard_as_unraisable(ctx->on_new_connection.ptr());
+        }
       }
       break;
     }
     case QUIC_LISTENER_EVENT_STOP_COMPLETE: {
       // 先に is_closing をセット
-      ctx->is_closing.store(true);
+      ctx->is_closing.store(true, std::memory_order_release);
       // GIL を取得してコールバックと connections をクリア
       nb::gil_scoped_acquire acquire;
-      ctx->on_new_connection = nullptr;
+      ctx->on_new_connection = nb::object();
+      // 残っている接続の親参照を外してからクリアする
+      for (auto& entry : ctx->connections) {
+        entry.second->context()->parent = nullptr;
+      }
       ctx->connections.clear();
       break;
     }
@@ -935,74 +1509,39 @@ void bind_enums(nb::module_& m) {
       .value("FINAL", QUIC_SEND_RESUMPTION_FLAG_FINAL);
 }
 
-// ========== Varint Functions ==========
-// QUIC Variable-Length Integer Encoding (RFC 9000 Section 16)
-// msquic の quic_var_int.h を使用
-
-nb::bytes encode_varint(uint64_t value) {
-  if (value > QUIC_VAR_INT_MAX) {
-    throw std::overflow_error("Value too large for varint encoding");
-  }
-
-  uint8_t buffer[8];
-  uint8_t* end = QuicVarIntEncode(value, buffer);
-  size_t size = static_cast<size_t>(end - buffer);
-
-  return nb::bytes(reinterpret_cast<char*>(buffer), size);
-}
-
-nb::tuple decode_varint(const nb::bytes& data, size_t offset = 0) {
-  size_t buffer_length = data.size();
-
-  if (offset >= buffer_length) {
-    throw std::out_of_range("Offset is out of range");
-  }
-
-  const uint8_t* buffer = reinterpret_cast<const uint8_t*>(data.c_str());
-  uint16_t pos = static_cast<uint16_t>(offset);
-  QUIC_VAR_INT value;
-
-  if (!QuicVarIntDecode(static_cast<uint16_t>(buffer_length), buffer, &pos,
-                        &value)) {
-    throw std::runtime_error("Insufficient data for varint decoding");
-  }
-
-  size_t consumed = static_cast<size_t>(pos - offset);
-  return nb::make_tuple(value, consumed);
-}
-
-uint8_t varint_size(uint64_t value) {
-  if (value > QUIC_VAR_INT_MAX) {
-    throw std::overflow_error("Value too large for varint encoding");
-  }
-  return static_cast<uint8_t>(QuicVarIntSize(value));
-}
-
 }  // namespace msquic_py
 
+void bind_varint(nb::module_& m);
+
 void bind_msquic(nb::module_& m) {
   using namespace msquic_py;
 
   m.doc() = "Python bindings for MsQuic";
 
-  // ユーティリティ関数
-  m.def("open_api", &open_api, "Open the MsQuic API");
-  m.def("close_api", &close_api, "Close the MsQuic API");
+  // MsQuic API の失敗用の例外型
+  nb::exception<QuicError>(m, "QuicError", PyExc_RuntimeError);
 
-  // Varint 関数
-  m.def("encode_varint", &encode_varint, "value"_a,
-        "Encode an integer as a QUIC variable-length integer");
-  m.def("decode_varint", &decode_varint, "data"_a, "offset"_a = 0,
-        "Decode a QUIC variable-length integer, returns (value, consumed_bytes)");
-  m.def("varint_size", &varint_size, "value"_a,
-        "Get the number of bytes required to encode a value as varint");
+  // ユーティリティ関数
+  // MsQuicOpenVersion はスレッド生成などのシステムコールを伴うため
+  // GIL を解放して呼び出す
+  m.def("open_api", &open_api, nb::call_guard<nb::gil_scoped_release>(),
+        "Open the MsQuic API");
+  m.def("close_api", &close_api, nb::call_guard<nb::gil_scoped_release>(),
+        "Close the MsQuic API");
+  m.def("set_execution_config", &set_execution_config,
+        "use_xdp"_a = false, "polling_idle_timeout_us"_a = 0,
+        "processor_list"_a = nb::list(),
+        "Set the global execution config (XDP / polling / worker processors)");
+
+  // Varint 関数 (bind_varint.cpp)
+  bind_varint(m);
 
   // Enums
   bind_enums(m);
 
   // Registration
   nb::class_<Registration>(m, "Registration")
-      .def(nb::init<const std::string&, QUIC_EXECUTION_PROFILE>(),
+      .def(nb::init<const char*, QUIC_EXECUTION_PROFILE>(),
            "app_name"_a, "profile"_a = QUIC_EXECUTION_PROFILE_LOW_LATENCY)
       .def("shutdown", &Registration::shutdown,
            "flags"_a = QUIC_CONNECTION_SHUTDOWN_FLAG_NONE, "error_code"_a = 0)
@@ -1010,7 +1549,8 @@ void bind_msquic(nb::module_& m) {
 
   // Configuration
   nb::class_<Configuration>(m, "Configuration")
-      .def(nb::init<Registration&, const std::vector<std::string>&, uint64_t, uint16_t, uint16_t, bool, QUIC_SERVER_RESUMPTION_LEVEL>(),
+      .def(nb::init<Registration&, nb::sequence, uint64_t, uint16_t, uint16_t,
+                    bool, QUIC_SERVER_RESUMPTION_LEVEL>(),
            "registration"_a, "alpn_list"_a, "idle_timeout_ms"_a = 0,
            "peer_bidi_stream_count"_a = 0, "peer_unidi_stream_count"_a = 0,
            "datagram_receive_enabled"_a = false,
@@ -1025,6 +1565,10 @@ void bind_msquic(nb::module_& m) {
   nb::class_<Stream>(m, "Stream")
       .def("start", &Stream::start, "flags"_a = QUIC_STREAM_START_FLAG_NONE)
       .def("send", &Stream::send, "data"_a, "flags"_a = QUIC_SEND_FLAG_NONE)
+      .def("send_many", &Stream::send_many, "payloads"_a, "flags"_a = QUIC_SEND_FLAG_NONE)
+      .def_prop_ro("pending_sends", &Stream::pending_sends)
+      .def("set_manual_receive", &Stream::set_manual_receive, "enabled"_a)
+      .def("receive_complete", &Stream::receive_complete)
       .def("shutdown", &Stream::shutdown, "flags"_a, "error_code"_a = 0)
       .def("set_on_receive", &Stream::set_on_receive)
       .def("set_on_send_complete", &Stream::set_on_send_complete)
@@ -0,0 +1,374 @@
+// nanobind
+#include <nanobind/nanobind.h>
+
+// msquic
+#include <msquic.h>
+
+// quic_var_int.h を使用するために必要なマクロを定義
+#ifndef QUIC_INLINE
+#define QUIC_INLINE static inline
+#endif
+#ifndef CXPLAT_DBG_ASSERT
+#define CXPLAT_DBG_ASSERT(exp)
+#endif
+#ifndef CXPLAT_ANALYSIS_ASSERT
+#define CXPLAT_ANALYSIS_ASSERT(exp)
+#endif
+
+// バイトスワップ関数: Windows (MSVC) と GCC/Clang で異なる
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <stdlib.h>
+#ifndef CxPlatByteSwapUint16
+#define CxPlatByteSwapUint16(value) _byteswap_ushort((unsigned short)(value))
+#endif
+#ifndef CxPlatByteSwapUint32
+#define CxPlatByteSwapUint32(value) _byteswap_ulong((unsigned long)(value))
+#endif
+#ifndef CxPlatByteSwapUint64
+#define CxPlatByteSwapUint64(value) _byteswap_uint64((unsigned long long)(value))
+#endif
+#else
+#ifndef CxPlatByteSwapUint16
+#define CxPlatByteSwapUint16(value) __builtin_bswap16((unsigned short)(value))
+#endif
+#ifndef CxPlatByteSwapUint32
+#define CxPlatByteSwapUint32(value) __builtin_bswap32((value))
+#endif
+#ifndef CxPlatByteSwapUint64
+#define CxPlatByteSwapUint64(value) __builtin_bswap64((value))
+#endif
+#endif
+
+#include <quic_var_int.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace nb = nanobind;
+using namespace nb::literals;
+
+namespace msquic_py {
+
+// ========== Varint Functions ==========
+// QUIC Variable-Length Integer Encoding (RFC 9000 Section 16)
+// msquic の quic_var_int.h を使用
+
+// 残り 8 バイト以上読める場合の分岐レス 1 要素デコード
+// 先頭バイトの上位 2 ビットから長さを求め、8 バイトロード +
+// バイトスワップ + マスクだけで値を取り出す。戻り値は消費バイト数
+// 最上位ビット位置から長さクラス (0-3, 長さは 1 << クラス) を求める
+// QUIC varint のペイロードは 6/14/30/62 ビット
+QUIC_INLINE unsigned varint_class(uint64_t value) {
+  static constexpr uint8_t kClassByBits[62] = {
+      0, 0, 0, 0, 0, 0,                                // 1-6 ビット
+      1, 1, 1, 1, 1, 1, 1, 1,                          // 7-14 ビット
+      2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,  // 15-30 ビット
+      3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,  // 31-62 ビット
+      3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+  };
+#ifdef _MSC_VER
+  unsigned long msb;
+  _BitScanReverse64(&msb, value | 1);
+  unsigned bits = static_cast<unsigned>(msb) + 1;
+#else
+  unsigned bits = 64 - static_cast<unsigned>(__builtin_clzll(value | 1));
+#endif
+  return kClassByBits[bits - 1];
+}
+
+// QuicVarIntEncode の 1 バイトずつの書き込みを、長さタグ合成 +
+// バイトスワップ + 先頭 length バイトの一括ストアに置き換えた
+// 分岐レスエンコード。戻り値は書き込んだバイト数
+QUIC_INLINE size_t encode_varint_fast(uint64_t value, uint8_t* buffer) {
+  unsigned length_class = varint_class(value);
+  size_t length = static_cast<size_t>(1) << length_class;
+  uint64_t raw = value | (static_cast<uint64_t>(length_class) << (length * 8 - 2));
+  raw = CxPlatByteSwapUint64(raw << ((8 - length) * 8));
+  std::memcpy(buffer, &raw, length);
+  return length;
+}
+
+QUIC_INLINE size_t decode_varint_fast(const uint8_t* buffer, uint64_t* value) {
+  size_t length = static_cast<size_t>(1) << (buffer[0] >> 6);
+  uint64_t raw;
+  std::memcpy(&raw, buffer, 8);
+  raw = CxPlatByteSwapUint64(raw) >> ((8 - length) * 8);
+  *value = raw & ((1ULL << (length * 8 - 2)) - 1);
+  return length;
+}
+
+nb::bytes encode_varint(uint64_t value) {
+  if (value > QUIC_VAR_INT_MAX) {
+    throw std::overflow_error("Value too large for varint encoding");
+  }
+
+  uint8_t buffer[8];
+  size_t size = encode_varint_fast(value, buffer);
+
+  // PyBytes は不変のため再利用はできない。nb::bytes コンストラクタの
+  // 経由をやめ、CPython API で直接構築して steal で包む
+  PyObject* result = PyBytes_FromStringAndSize(reinterpret_cast<char*>(buffer),
+                                               static_cast<Py_ssize_t>(size));
+  if (!result) {
+    throw nb::python_error();
+  }
+
+  return nb::steal<nb::bytes>(result);
+}
+
+// bytes はポインタと長さを直接参照し、それ以外はバッファプロトコル
+// 経由で取得する。has_view が真で返った場合は呼び出し側が
+// PyBuffer_Release で view を解放すること
+const uint8_t* varint_buffer_acquire(nb::handle data, size_t* buffer_length,
+                                     Py_buffer* view, bool* has_view) {
+  if (PyBytes_CheckExact(data.ptr())) {
+    *buffer_length = static_cast<size_t>(PyBytes_GET_SIZE(data.ptr()));
+    *has_view = false;
+    return reinterpret_cast<const uint8_t*>(PyBytes_AS_STRING(data.ptr()));
+  }
+  if (PyObject_GetBuffer(data.ptr(), view, PyBUF_SIMPLE) != 0) {
+    throw nb::python_error();
+  }
+  *buffer_length = static_cast<size_t>(view->len);
+  *has_view = true;
+  return reinterpret_cast<const uint8_t*>(view->buf);
+}
+
+nb::tuple decode_varint(nb::handle data, size_t offset = 0) {
+  // bytes は CPython の API を 1 回ずつ呼ぶだけで直接参照し、
+  // memoryview などはバッファプロトコル経由で実体化せずに読む
+  size_t buffer_length;
+  Py_buffer view;
+  bool has_view;
+  const uint8_t* buffer =
+      varint_buffer_acquire(data, &buffer_length, &view, &has_view);
+
+  if (offset >= buffer_length) {
+    if (has_view) {
+      PyBuffer_Release(&view);
+    }
+    throw std::out_of_range("Offset is out of range");
+  }
+
+  uint64_t value;
+  size_t consumed;
+
+  if (buffer_length - offset >= 8) {
+    // 長さ混在のストリームでも分岐予測ミスが出ないよう、
+    // 長さ分岐のないカーネルでデコードする
+    consumed = decode_varint_fast(buffer + offset, &value);
+  } else {
+    // 末尾付近は 8 バイトロードできないため、ゼロ埋めした
+    // スクラッチへコピーしてから同じカーネルでデコードする
+    size_t remaining = buffer_length - offset;
+    size_t length = static_cast<size_t>(1) << (buffer[offset] >> 6);
+    if (length > remaining) {
+      if (has_view) {
+        PyBuffer_Release(&view);
+      }
+      throw std::runtime_error("Insufficient data for varint decoding");
+    }
+    uint8_t scratch[8] = {};
+    std::memcpy(scratch, buffer + offset, remaining);
+    consumed = decode_varint_fast(scratch, &value);
+  }
+
+  if (has_view) {
+    PyBuffer_Release(&view);
+  }
+
+  return nb::make_tuple(value, consumed);
+}
+
+uint64_t decode_varint_first(nb::handle data) {
+  // 先頭の 1 値だけをデコードする高速経路
+  // タプルを生成せず値をそのまま返す。消費バイト数が必要な場合は
+  // 先頭バイトの上位 2 ビットから呼び出し側で求められる
+  size_t buffer_length;
+  Py_buffer view;
+  bool has_view;
+  const uint8_t* buffer =
+      varint_buffer_acquire(data, &buffer_length, &view, &has_view);
+
+  uint64_t value;
+
+  if (buffer_length == 0) {
+    if (has_view) {
+      PyBuffer_Release(&view);
+    }
+    // データ不足の例外型は decode_varint の IndexError に揃える
+    throw std::out_of_range("Data is empty");
+  }
+
+  if (buffer_length >= 8) {
+    decode_varint_fast(buffer, &value);
+  } else {
+    size_t length = static_cast<size_t>(1) << (buffer[0] >> 6);
+    if (length > buffer_length) {
+      if (has_view) {
+        PyBuffer_Release(&view);
+      }
+      throw std::runtime_error("Insufficient data for varint decoding");
+    }
+    uint8_t scratch[8] = {};
+    std::memcpy(scratch, buffer, buffer_length);
+    decode_varint_fast(scratch, &value);
+  }
+
+  if (has_view) {
+    PyBuffer_Release(&view);
+  }
+
+  return value;
+}
+
+size_t encode_varint_into(nb::bytearray& buf, size_t offset, uint64_t value) {
+  // 呼び出し側が用意した bytearray に直接書き込み、呼び出しごとの
+  // bytes 割り当てを避ける。戻り値は書き込み後の新しいオフセット
+  if (value > QUIC_VAR_INT_MAX) {
+    throw std::overflow_error("Value too large for varint encoding");
+  }
+
+  // offset + size は offset が SIZE_MAX 近傍のとき折り返すため、
+  // 減算の形で境界チェックする
+  size_t size = static_cast<size_t>(1) << varint_class(value);
+  if (offset > buf.size() || size > buf.size() - offset) {
+    throw std::out_of_range("Buffer too small for varint encoding");
+  }
+
+  uint8_t* ptr = reinterpret_cast<uint8_t*>(PyByteArray_AS_STRING(buf.ptr()));
+  encode_varint_fast(value, ptr + offset);
+  return offset + size;
+}
+
+nb::tuple decode_varints(nb::handle data, size_t offset = 0, Py_ssize_t count = -1) {
+  // 複数の varint を 1 回の呼び出しでまとめてデコードする
+  // 要素ごとのバインディング往復をなくし、残りが 8 バイト以上ある間は
+  // 分岐レスのデコードで進める
+  // 受け付ける型は decode_varint と同じ (bytes + バッファプロトコル)
+  size_t buffer_length;
+  Py_buffer view;
+  bool has_view;
+  const uint8_t* buffer =
+      varint_buffer_acquire(data, &buffer_length, &view, &has_view);
+
+  if (offset > buffer_length) {
+    if (has_view) {
+      PyBuffer_Release(&view);
+    }
+    throw std::out_of_range("Offset is out of range");
+  }
+
+  nb::list values;
+  size_t pos = offset;
+  Py_ssize_t decoded = 0;
+  while (pos < buffer_length && (count < 0 || decoded < count)) {
+    uint64_t value;
+    if (buffer_length - pos >= 8) {
+      pos += decode_varint_fast(buffer + pos, &value);
+    } else {
+      // 末尾付近は 8 バイトロードできないため、ゼロ埋めした
+      // スクラッチへコピーしてから同じカーネルでデコードする
+      size_t remaining = buffer_length - pos;
+      size_t length = static_cast<size_t>(1) << (buffer[pos] >> 6);
+      if (length > remaining) {
+        if (has_view) {
+          PyBuffer_Release(&view);
+        }
+        throw std::runtime_error("Insufficient data for varint decoding");
+      }
+      uint8_t scratch[8] = {};
+      std::memcpy(scratch, buffer + pos, remaining);
+      pos += decode_varint_fast(scratch, &value);
+    }
+    values.append(value);
+    decoded++;
+  }
+
+  if (has_view) {
+    PyBuffer_Release(&view);
+  }
+
+  if (count >= 0 && decoded < count) {
+    throw std::runtime_error("Insufficient data for varint decoding");
+  }
+
+  return nb::make_tuple(values, pos - offset);
+}
+
+uint8_t varint_size(uint64_t value) {
+  if (value > QUIC_VAR_INT_MAX) {
+    throw std::overflow_error("Value too large for varint encoding");
+  }
+
+  // QuicVarIntSize の比較の連鎖を、最上位ビット位置からの
+  // テーブル引きに置き換える (分岐なし)
+  return static_cast<uint8_t>(1) << varint_class(value);
+}
+
+nb::list varint_sizes(nb::sequence values) {
+  // 複数値のエンコードサイズを 1 回の呼び出しでまとめて求める
+  // フレームレイアウト計画のように値列全体のサイズが必要な場面で、
+  // 要素ごとのバインディング往復をなくす
+  nb::list sizes;
+  for (nb::handle item : values) {
+    sizes.append(varint_size(nb::cast<uint64_t>(item)));
+  }
+  return sizes;
+}
+
+nb::bytes encode_varints(nb::sequence values) {
+  // 複数の varint を 1 回の呼び出しでまとめてエンコードする
+  // 要素ごとの bytes 割り当てと結合をなくすため、先に合計サイズを
+  // 求めて 1 回の割り当てに書き込む
+  std::vector<uint64_t> extracted;
+  extracted.reserve(nb::len(values));
+
+  size_t total_size = 0;
+  for (nb::handle item : values) {
+    uint64_t value = nb::cast<uint64_t>(item);
+    if (value > QUIC_VAR_INT_MAX) {
+      throw std::overflow_error("Value too large for varint encoding");
+    }
+    total_size += static_cast<size_t>(1) << varint_class(value);
+    extracted.push_back(value);
+  }
+
+  PyObject* result =
+      PyBytes_FromStringAndSize(nullptr, static_cast<Py_ssize_t>(total_size));
+  if (!result) {
+    throw nb::python_error();
+  }
+
+  uint8_t* ptr = reinterpret_cast<uint8_t*>(PyBytes_AS_STRING(result));
+  for (uint64_t value : extracted) {
+    ptr += encode_varint_fast(value, ptr);
+  }
+
+  return nb::steal<nb::bytes>(result);
+}
+
+}  // namespace msquic_py
+
+void bind_varint(nb::module_& m) {
+  using namespace msquic_py;
+
+  m.def("encode_varint", &encode_varint, "value"_a,
+        "Encode an integer as a QUIC variable-length integer");
+  m.def("decode_varint", &decode_varint, "data"_a, "offset"_a = 0,
+        "Decode a QUIC variable-length integer, returns (value, consumed_bytes)");
+  m.def("decode_varint_first", &decode_varint_first, "data"_a,
+        "Decode the first QUIC variable-length integer, returns the value only");
+  m.def("encode_varint_into", &encode_varint_into, "buf"_a, "offset"_a, "value"_a,
+        "Encode a QUIC variable-length integer into a bytearray, returns the new offset");
+  m.def("encode_varints", &encode_varints, "values"_a,
+        "Encode multiple integers as QUIC variable-length integers into one bytes");
+  m.def("decode_varints", &decode_varints, "data"_a, "offset"_a = 0, "count"_a = -1,
+        "Decode multiple QUIC variable-length integers, returns (values, consumed_bytes)");
+  m.def("varint_size", &varint_size, "value"_a,
+        "Get the number of bytes required to encode a value as varint");
+  m.def("varint_sizes", &varint_sizes, "values"_a,
+        "Get the number of bytes required to encode each value as varint");
+}
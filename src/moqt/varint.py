@@ -46,8 +46,6 @@ def decode_varint(data: bytes | memoryview, offset: int = 0) -> tuple[int, int]:
     Raises:
         ValueError: データが不足している場合
     """
-    if isinstance(data, memoryview):
-        data = bytes(data)
     try:
         return _decode_varint(data, offset)
     except (RuntimeError, IndexError) as e:
@@ -5,6 +5,8 @@ aioquic で起動した QUIC サーバーに msquic-py クライアントから
 
 import threading
 
+import pytest
+
 import msquic
 
 
@@ -112,6 +114,198 @@ def test_echo_stream(quic_server):
     assert shutdown_event.wait(timeout=5.0), "Shutdown timeout"
 
 
+def test_echo_stream_send_many(quic_server):
+    """Echo ストリームで send_many を使うテスト"""
+    connected_event = threading.Event()
+    received_event = threading.Event()
+    shutdown_event = threading.Event()
+    received_data = []
+
+    # Registration 作成
+    reg = msquic.Registration("test_client", msquic.ExecutionProfile.LOW_LATENCY)
+
+    # Configuration 作成
+    config = msquic.Configuration(
+        reg,
+        quic_server["alpn"],
+        idle_timeout_ms=5000,
+    )
+    config.load_credential_none(no_certificate_validation=True)
+
+    # Connection 作成
+    conn = msquic.Connection(reg)
+
+    def on_connected(_session_resumed):
+        connected_event.set()
+
+    def on_shutdown_complete(_app_close_in_progress):
+        shutdown_event.set()
+
+    conn.set_on_connected(on_connected)
+    conn.set_on_shutdown_complete(on_shutdown_complete)
+
+    # 接続開始
+    conn.start(config, quic_server["host"], quic_server["port"])
+    assert connected_event.wait(timeout=5.0), "Connection timeout"
+
+    # Stream を開く
+    stream = conn.open_stream(msquic.StreamOpenFlags.NONE)
+
+    def on_receive(data, fin):
+        received_data.append(bytes(data))
+        if fin:
+            received_event.set()
+
+    stream.set_on_receive(on_receive)
+
+    # Stream 開始
+    stream.start(msquic.StreamStartFlags.IMMEDIATE)
+
+    # 複数バッファを 1 回の呼び出しで送信
+    payloads = [b"Hello, ", b"QUIC ", b"send_many!"]
+    stream.send_many(payloads, msquic.SendFlags.FIN)
+
+    # エコー応答を待機
+    assert received_event.wait(timeout=5.0), "Echo response timeout"
+
+    # 受信データを検証
+    assert b"".join(received_data) == b"".join(payloads)
+
+    # クリーンアップ
+    conn.shutdown(msquic.ConnectionShutdownFlags.NONE, 0)
+    assert shutdown_event.wait(timeout=5.0), "Shutdown timeout"
+
+
+def test_echo_stream_buffer_protocol(quic_server):
+    """bytes 以外のバッファプロトコルオブジェクトを送信するテスト"""
+    connected_event = threading.Event()
+    received_event = threading.Event()
+    shutdown_event = threading.Event()
+    received_data = []
+
+    # Registration 作成
+    reg = msquic.Registration("test_client", msquic.ExecutionProfile.LOW_LATENCY)
+
+    # Configuration 作成
+    config = msquic.Configuration(
+        reg,
+        quic_server["alpn"],
+        idle_timeout_ms=5000,
+    )
+    config.load_credential_none(no_certificate_validation=True)
+
+    # Connection 作成
+    conn = msquic.Connection(reg)
+
+    def on_connected(_session_resumed):
+        connected_event.set()
+
+    def on_shutdown_complete(_app_close_in_progress):
+        shutdown_event.set()
+
+    conn.set_on_connected(on_connected)
+    conn.set_on_shutdown_complete(on_shutdown_complete)
+
+    # 接続開始
+    conn.start(config, quic_server["host"], quic_server["port"])
+    assert connected_event.wait(timeout=5.0), "Connection timeout"
+
+    # Stream を開く
+    stream = conn.open_stream(msquic.StreamOpenFlags.NONE)
+
+    def on_receive(data, fin):
+        received_data.append(bytes(data))
+        if fin:
+            received_event.set()
+
+    stream.set_on_receive(on_receive)
+
+    # Stream 開始
+    stream.start(msquic.StreamStartFlags.IMMEDIATE)
+
+    # bytearray と memoryview を混在させて送信
+    payloads = [bytearray(b"Hello, "), memoryview(b"buffer "), b"protocol!"]
+    stream.send_many(payloads, msquic.SendFlags.FIN)
+
+    # エコー応答を待機
+    assert received_event.wait(timeout=5.0), "Echo response timeout"
+
+    # 受信データを検証
+    assert b"".join(received_data) == b"Hello, buffer protocol!"
+
+    # クリーンアップ
+    conn.shutdown(msquic.ConnectionShutdownFlags.NONE, 0)
+    assert shutdown_event.wait(timeout=5.0), "Shutdown timeout"
+
+
+def test_echo_stream_manual_receive(quic_server):
+    """手動 ACK モードで受信ウィンドウを制御するテスト"""
+    connected_event = threading.Event()
+    received_event = threading.Event()
+    shutdown_event = threading.Event()
+    received_data = []
+    fin_received = []
+
+    # Registration 作成
+    reg = msquic.Registration("test_client", msquic.ExecutionProfile.LOW_LATENCY)
+
+    # Configuration 作成
+    config = msquic.Configuration(
+        reg,
+        quic_server["alpn"],
+        idle_timeout_ms=5000,
+    )
+    config.load_credential_none(no_certificate_validation=True)
+
+    # Connection 作成
+    conn = msquic.Connection(reg)
+
+    def on_connected(_session_resumed):
+        connected_event.set()
+
+    def on_shutdown_complete(_app_close_in_progress):
+        shutdown_event.set()
+
+    conn.set_on_connected(on_connected)
+    conn.set_on_shutdown_complete(on_shutdown_complete)
+
+    # 接続開始
+    conn.start(config, quic_server["host"], quic_server["port"])
+    assert connected_event.wait(timeout=5.0), "Connection timeout"
+
+    # Stream を開く
+    stream = conn.open_stream(msquic.StreamOpenFlags.NONE)
+
+    def on_receive(data, fin):
+        received_data.append(bytes(data))
+        if fin:
+            fin_received.append(True)
+        received_event.set()
+
+    stream.set_on_receive(on_receive)
+    stream.set_manual_receive(True)
+
+    # Stream 開始
+    stream.start(msquic.StreamStartFlags.IMMEDIATE)
+
+    # データ送信
+    test_message = b"Hello, manual receive!"
+    stream.send(test_message, msquic.SendFlags.FIN)
+
+    # 受信のたびに receive_complete で消費を通知する
+    while not fin_received:
+        assert received_event.wait(timeout=5.0), "Echo response timeout"
+        received_event.clear()
+        stream.receive_complete()
+
+    # 受信データを検証
+    assert b"".join(received_data) == test_message
+
+    # クリーンアップ
+    conn.shutdown(msquic.ConnectionShutdownFlags.NONE, 0)
+    assert shutdown_event.wait(timeout=5.0), "Shutdown timeout"
+
+
 def test_multiple_streams(quic_server):
     """複数ストリームのテスト"""
     connected_event = threading.Event()
@@ -180,3 +374,30 @@ def test_multiple_streams(quic_server):
     # クリーンアップ
     conn.shutdown(msquic.ConnectionShutdownFlags.NONE, 0)
     assert shutdown_event.wait(timeout=5.0), "Shutdown timeout"
+
+
+def test_configuration_rejects_str_alpn():
+    """ALPN に str をそのまま渡すと TypeError になる"""
+    reg = msquic.Registration("test_client", msquic.ExecutionProfile.LOW_LATENCY)
+    with pytest.raises(TypeError):
+        msquic.Configuration(reg, "h3", idle_timeout_ms=5000)
+
+
+def test_configuration_rejects_bytes_alpn():
+    """ALPN に bytes をそのまま渡すと TypeError になる"""
+    reg = msquic.Registration("test_client", msquic.ExecutionProfile.LOW_LATENCY)
+    with pytest.raises(TypeError):
+        msquic.Configuration(reg, b"h3", idle_timeout_ms=5000)
+
+
+def test_quic_error_on_invalid_credential():
+    """存在しない証明書ファイルは QuicError になる"""
+    reg = msquic.Registration("test_client", msquic.ExecutionProfile.LOW_LATENCY)
+    config = msquic.Configuration(reg, ["echo"], idle_timeout_ms=5000)
+    with pytest.raises(msquic.QuicError):
+        config.load_credential_file("/nonexistent/cert.pem", "/nonexistent/key.pem")
+
+
+def test_quic_error_is_runtime_error():
+    """QuicError は RuntimeError の派生である"""
+    assert issubclass(msquic.QuicError, RuntimeError)
@@ -0,0 +1,166 @@
+"""msquic の varint バッチ API のテスト"""
+
+import pytest
+
+import msquic
+
+
+def test_decode_varints_all():
+    """データ末尾までまとめてデコードする"""
+    data = b"\x00" + b"\x40\x40" + b"\x80\x00\x40\x00" + b"\xc0\x00\x00\x00\x40\x00\x00\x00"
+    values, consumed = msquic.decode_varints(data)
+    assert values == [0, 64, 16384, 1073741824]
+    assert consumed == len(data)
+
+
+def test_decode_varints_count():
+    """count 指定で先頭から一部だけデコードする"""
+    data = b"\x01\x02\x03\x04"
+    values, consumed = msquic.decode_varints(data, count=2)
+    assert values == [1, 2]
+    assert consumed == 2
+
+
+def test_decode_varints_offset():
+    """offset 指定で途中からデコードする"""
+    data = b"\xff\x01\x02"
+    values, consumed = msquic.decode_varints(data, offset=1)
+    assert values == [1, 2]
+    assert consumed == 2
+
+
+def test_decode_varints_empty():
+    """空データは空リストを返す"""
+    values, consumed = msquic.decode_varints(b"")
+    assert values == []
+    assert consumed == 0
+
+
+def test_decode_varints_insufficient():
+    """途中で切れた varint はエラーになる"""
+    with pytest.raises(RuntimeError):
+        msquic.decode_varints(b"\x40")
+
+
+def test_decode_varints_count_insufficient():
+    """count に満たない場合はエラーになる"""
+    with pytest.raises(RuntimeError):
+        msquic.decode_varints(b"\x01", count=2)
+
+
+def test_decode_varints_memoryview():
+    """memoryview を bytes 化せずにまとめてデコードする"""
+    data = memoryview(b"\xff\x01\x02\x03")
+    values, consumed = msquic.decode_varints(data[1:])
+    assert values == [1, 2, 3]
+    assert consumed == 3
+
+
+def test_decode_varints_bytearray():
+    """bytearray をそのままデコードする"""
+    values, consumed = msquic.decode_varints(bytearray(b"\x40\x40\x00"))
+    assert values == [64, 0]
+    assert consumed == 3
+
+
+def test_decode_varint_memoryview():
+    """memoryview を bytes 化せずにデコードする"""
+    data = memoryview(b"\xff\x40\x40\xff")
+    value, consumed = msquic.decode_varint(data[1:3])
+    assert value == 64
+    assert consumed == 2
+
+
+def test_decode_varint_bytearray():
+    """bytearray をそのままデコードする"""
+    value, consumed = msquic.decode_varint(bytearray(b"\x80\x00\x40\x00"))
+    assert value == 16384
+    assert consumed == 4
+
+
+def test_decode_varint_first():
+    """先頭の 1 値だけをデコードする"""
+    assert msquic.decode_varint_first(b"\x00") == 0
+    assert msquic.decode_varint_first(b"\x40\x40\xff\xff") == 64
+    assert msquic.decode_varint_first(b"\xc0\x00\x00\x00\x40\x00\x00\x00") == 1073741824
+
+
+def test_decode_varint_first_empty():
+    """空データは decode_varint と同じ IndexError になる"""
+    with pytest.raises(IndexError):
+        msquic.decode_varint_first(b"")
+
+
+def test_decode_varint_first_insufficient():
+    """途中で切れた varint はエラーになる"""
+    with pytest.raises(RuntimeError):
+        msquic.decode_varint_first(b"\x80\x00")
+
+
+def test_encode_varints():
+    """複数値をまとめてエンコードする"""
+    data = msquic.encode_varints([0, 64, 16384, 1073741824])
+    assert data == b"\x00" + b"\x40\x40" + b"\x80\x00\x40\x00" + b"\xc0\x00\x00\x00\x40\x00\x00\x00"
+
+
+def test_encode_varints_empty():
+    """空シーケンスは空 bytes を返す"""
+    assert msquic.encode_varints([]) == b""
+
+
+def test_encode_varints_roundtrip():
+    """decode_varints との往復"""
+    values = [0, 1, 63, 64, 16383, 16384, 2**30 - 1, 2**30, 2**62 - 1]
+    data = msquic.encode_varints(values)
+    decoded, consumed = msquic.decode_varints(data)
+    assert decoded == values
+    assert consumed == len(data)
+
+
+def test_encode_varints_overflow():
+    """範囲外の値はエラーになる"""
+    with pytest.raises(OverflowError):
+        msquic.encode_varints([1, 2**62])
+
+
+def test_varint_sizes():
+    """複数値のエンコードサイズをまとめて求める"""
+    values = [0, 63, 64, 16383, 16384, 2**30 - 1, 2**30, 2**62 - 1]
+    assert msquic.varint_sizes(values) == [1, 1, 2, 2, 4, 4, 8, 8]
+
+
+def test_varint_sizes_empty():
+    """空シーケンスは空リストを返す"""
+    assert msquic.varint_sizes([]) == []
+
+
+def test_varint_sizes_overflow():
+    """範囲外の値はエラーになる"""
+    with pytest.raises(OverflowError):
+        msquic.varint_sizes([2**62])
+
+
+def test_encode_varint_into():
+    """bytearray への直接エンコード"""
+    buf = bytearray(16)
+    offset = msquic.encode_varint_into(buf, 0, 0)
+    assert offset == 1
+    offset = msquic.encode_varint_into(buf, offset, 64)
+    assert offset == 3
+    offset = msquic.encode_varint_into(buf, offset, 16384)
+    assert offset == 7
+    assert bytes(buf[:7]) == b"\x00\x40\x40\x80\x00\x40\x00"
+
+
+def test_encode_varint_into_too_small():
+    """バッファが足りない場合はエラーになる"""
+    buf = bytearray(1)
+    with pytest.raises(IndexError):
+        msquic.encode_varint_into(buf, 0, 64)
+
+
+def test_encode_varint_into_overflow():
+    """範囲外の値はエラーになる"""
+    buf = bytearray(8)
+    with pytest.raises(OverflowError):
+        msquic.encode_varint_into(buf, 0, 2**62)